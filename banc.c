@@ -0,0 +1,267 @@
+/* Banc d'essai du compilateur: generateurs de programmes synthetiques et
+   mesure des temps de compilation. Outil separe, le compilateur lui-meme
+   n'en contient rien; il est lance comme un programme ordinaire.
+
+   gcc -O2 -o banc banc.c
+   ./banc --gen si|fonctions|table|expr <lignes> [-o fichier]
+   ./banc --bench <lignes> [--compilateur chemin] [options du compilateur...] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+
+double nowSeconds(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* Programmes synthetiques deterministes, de taille reglable (en lignes
+   environ). Chaque forme charge une partie precise du compilateur. */
+
+// Chaines SI / SINON SI imbriquees sur 48 niveaux, repetees
+long synthSi(FILE *f, long lines){
+    long n = 3;
+    fprintf(f,"DEBUT\n    INT x\n    LIRE(x)\n");
+    while(n<lines){
+        int depth = 48;
+        for(int k=0;k<depth;k++){
+            fprintf(f,"%*sSI x > %d ALORS\n%*sx ~ x + 1\n",4+4*k,"",k,8+4*k,"");
+            n += 2;
+        }
+        for(int k=depth-1;k>=0;k--){
+            fprintf(f,"%*sSINON SI x == %d ALORS\n%*sx ~ x - 1\n"
+                      "%*sSINON\n%*sx ~ 0\n%*sFINSI\n",
+                4+4*k,"",k,8+4*k,"",4+4*k,"",8+4*k,"",4+4*k,"");
+            n += 5;
+        }
+    }
+    fprintf(f,"    ECRIRE x\nFIN\n");
+    return n+2;
+}
+
+// Milliers de fonctions, chacune appelant la precedente
+long synthFonctions(FILE *f, long lines){
+    long n = 0, k;
+    for(k=0;n<lines;k++){
+        fprintf(f,"FONCTION fonc%ld(INT a%ld, INT b%ld, FLOAT c%ld)\n"
+                  "    INT r%ld\n"
+                  "    FLOAT s%ld\n"
+                  "    r%ld ~ a%ld * 2 + b%ld - %ld\n"
+                  "    s%ld ~ c%ld * 0.5\n",
+            k,k,k,k, k, k, k,k,k,k%97, k,k);
+        if(k>0) fprintf(f,"    r%ld ~ r%ld + fonc%ld(b%ld, a%ld, s%ld)\n",k,k,k-1,k,k,k);
+        else fprintf(f,"    r%ld ~ r%ld + 1\n",k,k);
+        fprintf(f,"    RETOURNER r%ld\nFINFONCTION\n\n",k);
+        n += 10;
+    }
+    fprintf(f,"DEBUT\n    INT x\n    x ~ 0\n");
+    for(long i=0;i<k;i+=7)
+        fprintf(f,"    x ~ x + fonc%ld(x, %ld, 1.5)\n",i,i%13);
+    fprintf(f,"    ECRIRE x\nFIN\n");
+    return n+k/7+5;
+}
+
+// Beaucoup de grands tableaux, remplis et relus par des boucles POUR
+long synthTable(FILE *f, long lines){
+    long ntab = lines/5 > 1 ? lines/5 : 1;
+    fprintf(f,"DEBUT\n    INT i\n    INT s\n");
+    for(long k=0;k<ntab;k++)
+        fprintf(f,"    TABLE INT t%ld[1000]\n",k);
+    fprintf(f,"    s ~ 0\n");
+    for(long k=0;k<ntab;k++){
+        if(k==0) fprintf(f,"    POUR i DE 0 A 999\n        t0[i] ~ i\n    FINPOUR\n");
+        else fprintf(f,"    POUR i DE 0 A 999\n        t%ld[i] ~ t%ld[i] * 2 + t%ld[999 - i] - i\n    FINPOUR\n",
+            k,k-1,k-1);
+        fprintf(f,"    s ~ s + t%ld[%ld]\n",k,k%1000);
+    }
+    fprintf(f,"    ECRIRE s\nFIN\n");
+    return 5*ntab+6;
+}
+
+// Longues expressions: 64 termes parenthesees par affectation
+long synthExpr(FILE *f, long lines){
+    long n = 8;
+    fprintf(f,"DEBUT\n    INT a\n    INT b\n    INT c\n    INT x\n"
+              "    a ~ 3\n    b ~ 5\n    c ~ 7\n    x ~ 0\n");
+    for(long k=0;n<lines;k++,n++){
+        fprintf(f,"    x ~ x");
+        for(int t=0;t<64;t++){
+            static const char *ops[] = { "+", "-", "*", "+" };
+            static const char *vars[] = { "a", "b", "c", "x" };
+            if(t%8==0) fprintf(f," %s (%s * %d",ops[t%4],vars[(t+k)%4],(int)((t+k)%9)+1);
+            else if(t%8==7) fprintf(f," - %s / %d)",vars[t%4],t%5+1);
+            else fprintf(f," %s %s",ops[(t+k)%4],vars[(t*7+k)%4]);
+        }
+        fprintf(f,"\n");
+    }
+    fprintf(f,"    ECRIRE x\nFIN\n");
+    return n+2;
+}
+
+typedef struct { const char *name; long (*gen)(FILE*,long); } Generator;
+
+static const Generator generators[] = {
+    {"si",synthSi}, {"fonctions",synthFonctions}, {"table",synthTable}, {"expr",synthExpr},
+};
+#define NB_GENERATORS (int)(sizeof(generators)/sizeof(generators[0]))
+
+const Generator *findGenerator(const char *name){
+    for(int i=0;i<NB_GENERATORS;i++)
+        if(strcmp(generators[i].name,name)==0) return &generators[i];
+    return NULL;
+}
+
+// Lance le compilateur sur path, sorties jetees sauf stderr vers errFd (-1: jete)
+pid_t spawnCompiler(char **argv, int errFd){
+    pid_t pid = fork();
+    if(pid==0){
+        int null = open("/dev/null",O_WRONLY);
+        dup2(null,STDOUT_FILENO);
+        dup2(errFd>=0 ? errFd : null,STDERR_FILENO);
+        execv(argv[0],argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+// Nombre de lexemes du fichier, lu dans la ligne --stats du compilateur
+long countTokens(char **argv){
+    int fds[2];
+    if(pipe(fds)<0) return 0;
+    pid_t pid = spawnCompiler(argv,fds[1]);
+    close(fds[1]);
+
+    char buf[4096];
+    size_t len = 0;
+    ssize_t got;
+    while((got = read(fds[0],buf+len,sizeof(buf)-1-len))>0) len += got;
+    buf[len] = '\0';
+    close(fds[0]);
+    if(pid>0) waitpid(pid,NULL,0);
+
+    char *p = strstr(buf,"\"tokens\": ");
+    return p ? atol(p+10) : 0;
+}
+
+/* Chaque compilation tourne dans un processus fils: son pic de memoire
+   (wait4) ne depend pas des mesures precedentes. Meilleur temps sur reps. */
+int benchSuite(long lines, int reps, const char *compiler, char **extra, int nextra){
+    // compilateur, options, fichier, -o /dev/null [--stats]
+    char **argv = malloc((nextra+6)*sizeof(char*));
+    if(!argv){
+        fprintf(stderr,"Error: out of memory\n");
+        return 1;
+    }
+    argv[0] = (char*)compiler;
+    memcpy(argv+1,extra,nextra*sizeof(char*));
+    argv[nextra+2] = "-o";
+    argv[nextra+3] = "/dev/null";
+    argv[nextra+5] = NULL;
+
+    printf("%-10s %9s %10s %9s %13s %12s %9s\n",
+        "forme","lignes","lexemes","temps(s)","lexemes/s","lignes/s","RSS(Mo)");
+
+    for(int g=0;g<NB_GENERATORS;g++){
+        char path[] = "/tmp/algobench-XXXXXX.algo";
+        int fd = mkstemps(path,5);
+        FILE *f = fd>=0 ? fdopen(fd,"w") : NULL;
+        if(!f){
+            fprintf(stderr,"Error: cannot create a temporary file\n");
+            free(argv);
+            return 1;
+        }
+        long nlines = generators[g].gen(f,lines);
+        fclose(f);
+        argv[nextra+1] = path;
+
+        argv[nextra+4] = "--stats";
+        long tokens = countTokens(argv);
+        argv[nextra+4] = NULL;
+
+        double best = -1;
+        long rss = 0;
+        int failed = 0;
+        for(int r=0;r<reps && !failed;r++){
+            fflush(stdout);
+            double t0 = nowSeconds();
+            pid_t pid = spawnCompiler(argv,-1);
+            int wstatus = 0;
+            struct rusage ru;
+            if(pid<0 || wait4(pid,&wstatus,0,&ru)<0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus)!=0){
+                failed = 1;
+                break;
+            }
+            double dt = nowSeconds()-t0;
+            if(best<0 || dt<best) best = dt;
+            if(ru.ru_maxrss>rss) rss = ru.ru_maxrss;
+        }
+        unlink(path);
+
+        if(failed) printf("%-10s echec de la compilation\n",generators[g].name);
+        else printf("%-10s %9ld %10ld %9.3f %13.0f %12.0f %9.1f\n",
+            generators[g].name, nlines, tokens, best, tokens/best, nlines/best, rss/1024.0);
+    }
+    free(argv);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const Generator *gen = NULL;
+    const char *output_file = NULL;
+    const char *compiler = "./compilateur";
+    long genLines = 0, benchLines = 0;
+    int first = 1;
+
+    for (; first < argc; first++) {
+        if (strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+            output_file = argv[++first];
+        } else if (strcmp(argv[first], "--compilateur") == 0 && first + 1 < argc) {
+            compiler = argv[++first];
+        } else if (strcmp(argv[first], "--gen") == 0) {
+            if (first + 2 < argc && (gen = findGenerator(argv[first + 1])) && atol(argv[first + 2]) > 0) {
+                genLines = atol(argv[first + 2]);
+                first += 2;
+            } else {
+                fprintf(stderr, "Error: --gen option requires a shape (si, fonctions, table, expr) and a line count\n");
+                return 1;
+            }
+        } else if (strcmp(argv[first], "--bench") == 0) {
+            if (first + 1 < argc && atol(argv[first + 1]) > 0) {
+                benchLines = atol(argv[++first]);
+            } else {
+                fprintf(stderr, "Error: --bench option requires a line count\n");
+                return 1;
+            }
+        } else {
+            break;  // la suite est passee telle quelle au compilateur
+        }
+    }
+
+    if (gen && !benchLines && first == argc) {
+        FILE *f = output_file ? fopen(output_file, "w") : stdout;
+        if (f == NULL) {
+            fprintf(stderr, "Error: cannot open '%s'\n", output_file);
+            return 1;
+        }
+        gen->gen(f, genLines);
+        return fclose(f) == 0 ? 0 : 1;
+    }
+    if (benchLines && !gen && !output_file) {
+        if (access(compiler, X_OK) != 0) {
+            fprintf(stderr, "Error: cannot run compiler '%s'\n", compiler);
+            return 1;
+        }
+        return benchSuite(benchLines, 3, compiler, argv + first, argc - first);
+    }
+
+    fprintf(stderr, "Usage: %s --gen si|fonctions|table|expr <lines> [-o output_file]\n"
+                    "       %s --bench <lines> [--compilateur path] [compiler options...]\n",
+                    argv[0], argv[0]);
+    return 1;
+}
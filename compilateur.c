@@ -2,6 +2,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <dirent.h>
+#include <limits.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <pthread.h>
 
 typedef enum {
     TOK_DEBUT, TOK_FIN,
@@ -25,64 +43,447 @@ typedef enum {
 
 typedef struct {
     TokenType type;
-    char text[64];
+    const char *text;   // texte interne, jamais tronque
     int line, col;
 } Token;
 
 typedef enum { TYPE_INT, TYPE_CHAR, TYPE_FLOAT, TYPE_TABLE } VarType;
 typedef enum { SYM_VAR, SYM_FUNC } SymKind;
 
-typedef struct {
-    char name[64];
+/* Arene: gros blocs alloues a la demande et liberes d'un coup en fin de
+   compilation. Symboles, noms et listes de parametres y vivent. */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used, cap;
+    char data[];
+} ArenaBlock;
+
+typedef struct { ArenaBlock *head; size_t total; } Arena;
+
+#define ARENA_BLOCK (64*1024)
+
+typedef struct Symbol Symbol;
+struct Symbol {
+    const char *name;   // nom interne (comparaison par pointeur)
     SymKind kind;
     VarType vtype;
     int arraySize;
     int paramCount;
-    VarType paramTypes[10];
+    VarType *paramTypes;
     int scope;
-} Symbol;
+    Symbol *next;       // symbole suivant dans le meme seau
+    Symbol *scopeNext;  // symbole precedent de la meme portee
+    int reads;          // lectures comptees par l'elimination de code mort
+    unsigned char pinned, dead;
+    int slot;           // case du cadre (variables) ou numero de fonction pour la VM
+    int reg;            // --asm: registre alloue, -1 en memoire (decalage dans slot)
+    int loopMark;       // ecrit dans la boucle en cours d'optimisation
+    struct Node *inlineExpr;   // FONCTION recopiee aux appels: copie de son RETOURNER
+    Symbol **inlineParams;
+};
+
+/* Pile de portees: symboles de chaque portee, du plus recent au plus ancien.
+   Portee 0 = fonctions, puis une portee par corps de fonction ou par main. */
+#define MAX_SCOPES 16
+
+typedef struct { const char *str; unsigned len, hash; } InternEntry;
+
+/* Mesures de --stats: temps par phase (secondes) et compteurs. Le temps
+   d'analyse syntaxique exclut celui passe dans le lexer. */
+typedef struct {
+    double lex, parse, sema, opt, gen, io;
+    long tokens, symbols;
+    long lookups, probes, maxProbe;   // findSymbol: appels, maillons parcourus
+    long long bytesOut;
+    long regionsReused, regionsCompiled;   // --incremental
+} Stats;
+typedef struct Bytecode Bytecode;
+typedef struct AsmState AsmState;
+
+// Erreur signalee, gardee pour le rapport JSON (--erreurs-json)
+typedef struct {
+    const char *kind;   // "lexicale", "syntaxique" ou "semantique"
+    int line, col;
+    const char *msg, *text;
+} Diagnostic;
+
+/* Etat d'une compilation. Chaque fichier compile a le sien, ce qui permet
+   d'en compiler plusieurs en parallele; 'cc' designe celle du thread courant. */
+typedef struct {
+    Arena arena;
+
+    // Source et lexer
+    FILE *src;
+    const char *srcBuf;
+    size_t srcLen, srcPos;
+    int srcMapped;
+    int line, col;
+    Token current;
+    int prevLine;           // ligne du token precedent
+    char *lexText;
+    size_t lexLen, lexCap;
+
+    /* Noms internes: chaque texte distinct est stocke une seule fois dans l'arene,
+       ce qui permet de comparer les noms par pointeur. Adressage ouvert. */
+    InternEntry *internTab;
+    unsigned internCap, internCount;
+
+    /* Table de hachage des symboles: chaque seau est une liste chainee, le plus
+       recent en tete (masquage naturel). Elle double quand elle se remplit. */
+    Symbol **symBuckets;
+    unsigned symBucketCount;
+    int symCount;
+    Symbol *scopeHead[MAX_SCOPES];
+    int currentScope;
+    int inFunction;
+    int currentFunction;    // ordre de la fonction analysee (INT_MAX pour main)
+    int forwardCalls;       // appel d'une fonction definie plus loin: prototypes
+    int runtimes;           // runtimes du C genere (RT_SORTIE...) ecrits dans l'en-tete
+    int streamDecl;         // source en flux: fonctions declarees au fil de la lecture
+
+    // Generation: le C est accumule dans outBuf puis ecrit sur outFd
+    int outFd;
+    char *outBuf;
+    size_t outLen, outCap;
+    int outToMemory;
+    int indent;
+    Bytecode *bc;
+    AsmState *asmState;     // --asm: etat du programme en cours d'ecriture
+    const char *prevOut;    // --incremental: sortie precedente projetee
+    size_t prevOutLen;
+
+    // Diagnostics: stderr, ou un flux propre au fichier en compilation par lot
+    FILE *diag;
+    jmp_buf failure;
+    jmp_buf *recover;       // point de reprise le plus proche (--max-erreurs)
+    Diagnostic *errors;
+    int errorCount, errorCap;
+    int errorLine;          // ligne de la derniere erreur, pour la resynchronisation
+    int inHeader;           // en-tete de SI, POUR ou TANTQUE en cours d'analyse
+    long nbFolded, nbSimplified;
+    long nbDeadBranches, nbUnreachable, nbUnusedVars;
+    long nbHoisted, nbReduced;
+    long nbSimd, nbSimdCandidates;
+    long nbParallel, nbParallelCandidates;
+    long nbInlined;
+    int loopStamp, loopTemps, inlineTemps;
+    Stats stats;
+} Compilation;
+
+_Thread_local Compilation *cc = NULL;
+
+/* Source en memoire: le fichier est projete (mmap) ou lu d'un bloc, puis
+   parcouru par un curseur. Le mode flux (fgetc/ungetc) reste disponible
+   pour stdin et les pipes. */
+int streamMode = 0;
+
+int statsMode = 0;   // --stats: mesures de chaque compilation en JSON
+
+double nowSeconds(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Abandonne la compilation courante; le diagnostic a deja ete ecrit
+void compileFailed(){
+    longjmp(cc->failure,1);
+}
+
+void fatal(const char *msg){
+    fprintf(cc->diag,"ERREUR: %s\n",msg);
+    compileFailed();
+}
+
+void *arenaAlloc(Arena *a, size_t n){
+    n = (n+15) & ~(size_t)15;
+    ArenaBlock *b = a->head;
+    if(!b || b->used+n > b->cap){
+        size_t cap = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+        b = malloc(sizeof(ArenaBlock)+cap);
+        if(!b) fatal("memoire insuffisante");
+        b->used=0; b->cap=cap;
+        b->next=a->head;
+        a->head=b;
+        a->total+=cap;
+    }
+    void *p = b->data+b->used;
+    b->used+=n;
+    return p;
+}
+
+void arenaFree(Arena *a){
+    while(a->head){
+        ArenaBlock *n = a->head->next;
+        free(a->head);
+        a->head=n;
+    }
+    a->total=0;
+}
 
-#define MAX_SYMS 256
-Symbol symtab[MAX_SYMS];
-int symCount = 0;
+/* Erreurs multiples: avec --max-erreurs N (N>1), une erreur saute au point
+   de reprise le plus proche (instruction ou declaration) au lieu d'abandonner
+   la compilation; celle-ci echoue quand meme, apres l'analyse. La N-ieme
+   erreur, ou une erreur hors de tout point de reprise, l'arrete aussitot.
+   Avec --erreurs-json, les erreurs sont gardees et ecrites en un seul rapport. */
+int maxErrors = 1;
+int errorsJson = 0;
+
+void recordError(const char *kind, int line, int col, const char *msg, const char *text){
+    if(cc->errorCount==cc->errorCap){
+        int cap = cc->errorCap ? 2*cc->errorCap : 16;
+        Diagnostic *bigger = realloc(cc->errors,cap*sizeof(Diagnostic));
+        if(!bigger) fatal("memoire insuffisante");
+        cc->errors = bigger;
+        cc->errorCap = cap;
+    }
+    cc->errors[cc->errorCount++] = (Diagnostic){ kind, line, col, msg, text };
+    cc->errorLine = line;
+    if(maxErrors>1 && cc->errorCount==maxErrors && !errorsJson)
+        fprintf(cc->diag,"ERREUR: %d erreurs, compilation interrompue\n",maxErrors);
+}
 
-int currentScope = 0;
-int inFunction = 0;
+int canRecover(){
+    return cc->recover && cc->errorCount<maxErrors;
+}
 
-FILE *src, *out;
-Token current;
-int line = 1, col = 0, indent = 0;
+// Reprend au point de reprise le plus proche, ou abandonne la compilation
+void errorRaised(){
+    if(canRecover()) longjmp(*cc->recover,1);
+    compileFailed();
+}
 
 void syn_error(Token t, const char *msg){
-    fprintf(stderr,
-        "ERREUR SYNTAXIQUE [%d:%d] %s -> '%s'\n",
-        t.line, t.col, msg, t.text);
-    exit(1);
+    // Suite probable de l'erreur precedente sur la meme ligne: reprise sans la signaler
+    if(cc->errorCount && t.line==cc->errorLine && canRecover()) longjmp(*cc->recover,1);
+    if(!errorsJson)
+        fprintf(cc->diag,
+            "ERREUR SYNTAXIQUE [%d:%d] %s -> '%s'\n",
+            t.line, t.col, msg, t.text);
+    recordError("syntaxique",t.line,t.col,msg,t.text);
+    errorRaised();
 }
 
 void sem_error(Token t, const char *msg){
-    fprintf(stderr,
-        "ERREUR SEMANTIQUE [%d:%d] %s -> '%s'\n",
-        t.line, t.col, msg, t.text);
-    exit(1);
+    if(!errorsJson)
+        fprintf(cc->diag,
+            "ERREUR SEMANTIQUE [%d:%d] %s -> '%s'\n",
+            t.line, t.col, msg, t.text);
+    recordError("semantique",t.line,t.col,msg,t.text);
+    errorRaised();
+}
+
+// Le lexer continue apres une erreur (caractere saute) si la reprise est possible
+void lexicalError(int line, int col, const char *msg, const char *text){
+    recordError("lexicale",line,col,msg,text);
+    if(!canRecover()) compileFailed();
+}
+
+// Les erreurs ont ete reprises: la compilation s'arrete avant l'optimisation
+void stopOnErrors(){
+    if(cc->errorCount) compileFailed();
+}
+
+/* Tampon de sortie du C genere: ajouts d'octets sans analyse de format,
+   ecrits sur le descripteur par blocs de OUT_BUFFER octets. En memoire
+   (serveur), le tampon grandit et contient tout le C a la fin. */
+#define OUT_BUFFER (1<<18)
+
+void outFlush(){
+    if(cc->outToMemory){
+        char *bigger = realloc(cc->outBuf,2*cc->outCap);
+        if(!bigger) fatal("memoire insuffisante");
+        cc->outBuf = bigger;
+        cc->outCap *= 2;
+        return;
+    }
+    double t0 = statsMode ? nowSeconds() : 0;
+    cc->stats.bytesOut += cc->outLen;
+    for(size_t off=0;off<cc->outLen;){
+        ssize_t w = write(cc->outFd,cc->outBuf+off,cc->outLen-off);
+        if(w<0){
+            if(errno==EINTR) continue;
+            fatal("ecriture du fichier de sortie impossible");
+        }
+        off += (size_t)w;
+    }
+    cc->outLen = 0;
+    if(statsMode) cc->stats.io += nowSeconds()-t0;
+}
+
+/* Tampon memoire: place en tete les octets ecrits depuis 'mark' (en-tete
+   connu seulement une fois les corps generes). */
+void outMoveToFront(size_t mark){
+    size_t n = cc->outLen-mark;
+    char *head = malloc(n ? n : 1);
+    if(!head) fatal("memoire insuffisante");
+    memcpy(head,cc->outBuf+mark,n);
+    memmove(cc->outBuf+n,cc->outBuf,mark);
+    memcpy(cc->outBuf,head,n);
+    free(head);
+}
+
+static inline void outMem(const char *s, size_t n){
+    while(cc->outLen+n > cc->outCap){
+        size_t part = cc->outCap-cc->outLen;
+        memcpy(cc->outBuf+cc->outLen,s,part);
+        cc->outLen = cc->outCap;
+        outFlush();
+        s += part;
+        n -= part;
+    }
+    memcpy(cc->outBuf+cc->outLen,s,n);
+    cc->outLen += n;
 }
 
+static inline void outStr(const char *s){
+    outMem(s,strlen(s));
+}
+
+static inline void outChar(char c){
+    if(cc->outLen==cc->outCap) outFlush();
+    cc->outBuf[cc->outLen++] = c;
+}
+
+void outInt(long v){
+    char buf[24];
+    int i = sizeof(buf);
+    unsigned long u = v<0 ? -(unsigned long)v : (unsigned long)v;
+    do { buf[--i] = '0'+u%10; u /= 10; } while(u);
+    if(v<0) buf[--i] = '-';
+    outMem(buf+i,sizeof(buf)-i);
+}
+
+// Indentation prete pour 16 niveaux, recopiee par morceaux au-dela
+static const char indentSpaces[] =
+    "                                                                ";
+
 void printIndent(){
-    for(int i=0;i<indent;i++) fprintf(out,"    ");
+    size_t n = 4*(size_t)cc->indent;
+    for(;n>sizeof(indentSpaces)-1;n-=sizeof(indentSpaces)-1)
+        outMem(indentSpaces,sizeof(indentSpaces)-1);
+    outMem(indentSpaces,n);
+}
+
+static inline unsigned hashBytes(const char *s, size_t len){
+    unsigned h = 2166136261u;
+    for(size_t i=0;i<len;i++){ h ^= (unsigned char)s[i]; h *= 16777619u; }
+    return h;
 }
 
-int findSymbol(const char *name, SymKind kind){
-    for(int i=symCount-1;i>=0;i--){
-        if(!strcmp(symtab[i].name,name) &&
-           (kind==-1 || symtab[i].kind==kind))
-            return i;
+const char *intern(const char *s, size_t len){
+    unsigned h = hashBytes(s,len);
+    if(2*(cc->internCount+1) > cc->internCap){
+        unsigned ncap = cc->internCap ? cc->internCap*2 : 1024;
+        InternEntry *nt = calloc(ncap,sizeof(InternEntry));
+        if(!nt) fatal("memoire insuffisante");
+        for(unsigned i=0;i<cc->internCap;i++){
+            if(!cc->internTab[i].str) continue;
+            unsigned j=cc->internTab[i].hash&(ncap-1);
+            while(nt[j].str) j=(j+1)&(ncap-1);
+            nt[j]=cc->internTab[i];
+        }
+        free(cc->internTab);
+        cc->internTab=nt; cc->internCap=ncap;
     }
-    return -1;
+
+    unsigned i=h&(cc->internCap-1);
+    for(;cc->internTab[i].str;i=(i+1)&(cc->internCap-1)){
+        if(cc->internTab[i].hash==h && cc->internTab[i].len==len &&
+           !memcmp(cc->internTab[i].str,s,len))
+            return cc->internTab[i].str;
+    }
+
+    char *copy = arenaAlloc(&cc->arena,len+1);
+    memcpy(copy,s,len);
+    copy[len]=0;
+    cc->internTab[i].str=copy;
+    cc->internTab[i].len=(unsigned)len;
+    cc->internTab[i].hash=h;
+    cc->internCount++;
+    return copy;
+}
+
+// Les noms etant internes, le hachage porte sur le pointeur
+static inline unsigned symBucket(const char *key){
+    return (unsigned)(((size_t)key >> 4) * 2654435761u) & (cc->symBucketCount-1);
+}
+
+void initSymbols(){
+    cc->symBucketCount=1024;
+    free(cc->symBuckets);
+    cc->symBuckets=calloc(cc->symBucketCount,sizeof(Symbol*));
+    if(!cc->symBuckets) fatal("memoire insuffisante");
+    cc->symCount=0;
+    cc->currentScope=0;
+    cc->scopeHead[0]=NULL;
+}
+
+// Double le nombre de seaux; l'ordre relatif des homonymes est conserve
+void growSymbols(){
+    unsigned oldCount=cc->symBucketCount;
+    Symbol **old=cc->symBuckets;
+    Symbol **buckets=calloc(2*oldCount,sizeof(Symbol*));
+    Symbol **tail=calloc(2*oldCount,sizeof(Symbol*));
+    if(!buckets || !tail){
+        free(buckets);
+        free(tail);
+        fatal("memoire insuffisante");
+    }
+    cc->symBucketCount*=2;
+    cc->symBuckets=buckets;
+    for(unsigned b=0;b<oldCount;b++){
+        Symbol *s=old[b];
+        while(s){
+            Symbol *n=s->next;
+            unsigned nb=symBucket(s->name);
+            s->next=NULL;
+            if(tail[nb]) tail[nb]->next=s;
+            else cc->symBuckets[nb]=s;
+            tail[nb]=s;
+            s=n;
+        }
+    }
+    free(tail);
+    free(old);
+}
+
+void pushScope(){
+    if(cc->currentScope+1>=MAX_SCOPES){
+        fatal("trop de portees imbriquees");
+    }
+    cc->currentScope++;
+    cc->scopeHead[cc->currentScope]=NULL;
+}
+
+void popScope(){
+    for(Symbol *s=cc->scopeHead[cc->currentScope];s;s=s->scopeNext){
+        Symbol **p=&cc->symBuckets[symBucket(s->name)];
+        while(*p!=s) p=&(*p)->next;
+        *p=s->next;
+        cc->symCount--;
+    }
+    cc->currentScope--;
+}
+
+Symbol *findSymbol(const char *name, SymKind kind){
+    long probes = 0;
+    Symbol *s;
+    for(s=cc->symBuckets[symBucket(name)];s;s=s->next){
+        probes++;
+        if(s->name==name &&
+           (kind==-1 || s->kind==kind))
+            break;
+    }
+    cc->stats.lookups++;
+    cc->stats.probes += probes;
+    if(probes>cc->stats.maxProbe) cc->stats.maxProbe = probes;
+    return s;
 }
 
-VarType getSymbolType(int idx){
-    if(idx<0) return TYPE_INT;
-    return symtab[idx].vtype;
+VarType getSymbolType(Symbol *sym){
+    if(!sym) return TYPE_INT;
+    return sym->vtype;
 }
 
 const char* typeToCStr(VarType t){
@@ -95,54 +496,201 @@ const char* typeToCStr(VarType t){
     }
 }
 
-void addSymbolTyped(const char *name, SymKind kind, int params, VarType vtype, int arrSize);
+// Declare le symbole nomme par le token 'at' dans la portee courante
+Symbol *addSymbolTyped(Token at, SymKind kind, int params, VarType vtype, int arrSize){
+    const char *name = at.text;
+    // Double declaration: uniquement dans la portee courante
+    if(kind==SYM_VAR){
+        for(Symbol *s=cc->symBuckets[symBucket(name)];s;s=s->next){
+            if(s->name==name && s->kind==SYM_VAR){
+                if(s->scope==cc->currentScope)
+                    sem_error(at,"Double declaration de variable");
+                break;
+            }
+        }
+    }
+
+    if((unsigned)cc->symCount >= 2*cc->symBucketCount)
+        growSymbols();
 
-void addSymbol(const char *name, SymKind kind, int params){
-    addSymbolTyped(name, kind, params, TYPE_INT, 0);
+    Symbol *sym = arenaAlloc(&cc->arena,sizeof(Symbol));
+    memset(sym,0,sizeof(Symbol));
+    unsigned b = symBucket(name);
+    sym->name=name;
+    sym->kind=kind;
+    sym->paramCount=params;
+    sym->paramTypes=NULL;
+    sym->vtype=vtype;
+    sym->arraySize=arrSize;
+    sym->scope=cc->currentScope;
+    sym->next=cc->symBuckets[b];
+    cc->symBuckets[b]=sym;
+    sym->scopeNext=cc->scopeHead[cc->currentScope];
+    cc->scopeHead[cc->currentScope]=sym;
+    cc->symCount++;
+    cc->stats.symbols++;
+    return sym;
 }
 
-void addSymbolTyped(const char *name, SymKind kind, int params, VarType vtype, int arrSize){
-    if(kind==SYM_VAR && findSymbol(name,SYM_VAR)!=-1 && currentScope==1)
-        sem_error(current,"Double declaration de variable");
+Symbol *addFunctionSymbol(Token at, int params, VarType paramTypes[]){
+    if(findSymbol(at.text,SYM_FUNC))
+        sem_error(at,"Double declaration de fonction");
 
-    strcpy(symtab[symCount].name,name);
-    symtab[symCount].kind=kind;
-    symtab[symCount].paramCount=params;
-    symtab[symCount].vtype=vtype;
-    symtab[symCount].arraySize=arrSize;
-    symtab[symCount].scope=currentScope;
-    symCount++;
+    Symbol *sym = addSymbolTyped(at,SYM_FUNC,params,TYPE_INT,0);
+    sym->paramTypes = arenaAlloc(&cc->arena,(params ? params : 1)*sizeof(VarType));
+    memcpy(sym->paramTypes,paramTypes,params*sizeof(VarType));
+    return sym;
 }
 
-void addFunctionSymbol(const char *name, int params, VarType paramTypes[]){
-    if(findSymbol(name,SYM_FUNC)!=-1)
-        sem_error(current,"Double declaration de fonction");
+/* Mots-cles du pseudo-code (voir KEYWORDS.txt) */
+typedef struct { const char *text; TokenType type; } Keyword;
 
-    strcpy(symtab[symCount].name,name);
-    symtab[symCount].kind=SYM_FUNC;
-    symtab[symCount].paramCount=params;
-    symtab[symCount].vtype=TYPE_INT;
-    symtab[symCount].arraySize=0;
-    symtab[symCount].scope=currentScope;
+static const Keyword keywords[] = {
+    {"DEBUT",TOK_DEBUT}, {"FIN",TOK_FIN},
+    {"INT",TOK_INT}, {"CHAR",TOK_CHAR}, {"FLOAT",TOK_FLOAT}, {"TABLE",TOK_TABLE},
+    {"FONCTION",TOK_FONCTION}, {"FINFONCTION",TOK_FINFONCTION},
+    {"RETOURNER",TOK_RETOURNER},
+    {"ECRIRE",TOK_ECRIRE}, {"LIRE",TOK_LIRE},
+    {"POUR",TOK_POUR}, {"FINPOUR",TOK_FINPOUR},
+    {"TANTQUE",TOK_TANTQUE}, {"FINTANTQUE",TOK_FINTANTQUE},
+    {"REPETER",TOK_REPETER},
+    {"SI",TOK_SI}, {"ALORS",TOK_ALORS}, {"SINON",TOK_SINON}, {"FINSI",TOK_FINSI},
+    {"DE",TOK_DE}, {"A",TOK_A},
+};
+#define NB_KEYWORDS (int)(sizeof(keywords)/sizeof(keywords[0]))
 
-    for(int i=0;i<params;i++){
-        symtab[symCount].paramTypes[i]=paramTypes[i];
-    }
+int lexLinear = 0;
+
+// Ancienne classification: comparaison avec chaque mot-cle (reference pour --bench-lex)
+TokenType keywordLinear(const char *s){
+    for(int i=0;i<NB_KEYWORDS;i++)
+        if(!strcmp(s,keywords[i].text)) return keywords[i].type;
+    return TOK_ID;
+}
+
+#define KW(str,tok) if(!memcmp(s,str,sizeof(str)-1)) return tok
 
-    symCount++;
+// Classification par longueur puis premiere lettre: au plus un memcmp
+static inline TokenType keywordType(const char *s, int len){
+    if(s[0]<'A' || s[0]>'T') return TOK_ID;
+    switch(len){
+        case 1: if(s[0]=='A') return TOK_A; break;
+        case 2:
+            if(s[0]=='S'){ KW("SI",TOK_SI); }
+            else if(s[0]=='D'){ KW("DE",TOK_DE); }
+            break;
+        case 3:
+            if(s[0]=='F'){ KW("FIN",TOK_FIN); }
+            else if(s[0]=='I'){ KW("INT",TOK_INT); }
+            break;
+        case 4:
+            if(s[0]=='C'){ KW("CHAR",TOK_CHAR); }
+            else if(s[0]=='L'){ KW("LIRE",TOK_LIRE); }
+            else if(s[0]=='P'){ KW("POUR",TOK_POUR); }
+            break;
+        case 5:
+            switch(s[0]){
+                case 'D': KW("DEBUT",TOK_DEBUT); break;
+                case 'T': KW("TABLE",TOK_TABLE); break;
+                case 'A': KW("ALORS",TOK_ALORS); break;
+                case 'S': KW("SINON",TOK_SINON); break;
+                case 'F':
+                    if(s[1]=='L'){ KW("FLOAT",TOK_FLOAT); }
+                    else { KW("FINSI",TOK_FINSI); }
+                    break;
+            }
+            break;
+        case 6: if(s[0]=='E'){ KW("ECRIRE",TOK_ECRIRE); } break;
+        case 7:
+            if(s[0]=='T'){ KW("TANTQUE",TOK_TANTQUE); }
+            else if(s[0]=='R'){ KW("REPETER",TOK_REPETER); }
+            else if(s[0]=='F'){ KW("FINPOUR",TOK_FINPOUR); }
+            break;
+        case 8: if(s[0]=='F'){ KW("FONCTION",TOK_FONCTION); } break;
+        case 9: if(s[0]=='R'){ KW("RETOURNER",TOK_RETOURNER); } break;
+        case 10: if(s[0]=='F'){ KW("FINTANTQUE",TOK_FINTANTQUE); } break;
+        case 11: if(s[0]=='F'){ KW("FINFONCTION",TOK_FINFONCTION); } break;
+    }
+    return TOK_ID;
 }
 
-int nextChar(){
-    int c = fgetc(src);
-    col++;
-    if(c=='\n'){ line++; col=0; }
+#undef KW
+
+static inline int nextChar(){
+    int c;
+    if(!streamMode)
+        c = cc->srcPos<cc->srcLen ? (unsigned char)cc->srcBuf[cc->srcPos++] : EOF;
+    else
+        c = fgetc(cc->src);
+    cc->col++;
+    if(c=='\n'){ cc->line++; cc->col=0; }
     return c;
 }
 
-void unreadChar(int c){
-    if(c=='\n') line--;
-    else col--;
-    ungetc(c,src);
+static inline void unreadChar(int c){
+    if(c=='\n') cc->line--;
+    else cc->col--;
+    if(!streamMode){
+        if(c!=EOF) cc->srcPos--;
+    }
+    else ungetc(c,cc->src);
+}
+
+int loadSource(const char *path){
+    int fd = open(path,O_RDONLY);
+    if(fd<0) return -1;
+
+    struct stat st;
+    if(fstat(fd,&st)==0 && S_ISREG(st.st_mode) && st.st_size>0){
+        void *p = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if(p!=MAP_FAILED){
+            madvise(p,(size_t)st.st_size,MADV_SEQUENTIAL);
+            cc->srcBuf=p; cc->srcLen=(size_t)st.st_size; cc->srcPos=0; cc->srcMapped=1;
+            close(fd);
+            return 0;
+        }
+    }
+
+    // Pas projetable (pipe, fichier special): lecture par gros blocs
+    size_t cap = 1<<16, len = 0;
+    char *buf = malloc(cap);
+    ssize_t n;
+    while(buf && (n = read(fd,buf+len,cap-len)) > 0){
+        len += (size_t)n;
+        if(len==cap){
+            cap *= 2;
+            char *nb = realloc(buf,cap);
+            if(!nb){ free(buf); buf=NULL; }
+            buf = nb;
+        }
+    }
+    close(fd);
+    if(!buf || n<0){ free(buf); return -1; }
+    cc->srcBuf=buf; cc->srcLen=len; cc->srcPos=0; cc->srcMapped=0;
+    return 0;
+}
+
+void unloadSource(){
+    if(cc->srcMapped) munmap((void*)cc->srcBuf,cc->srcLen);
+    else free((void*)cc->srcBuf);
+    cc->srcBuf=NULL; cc->srcLen=cc->srcPos=0;
+}
+
+// Tampon de travail du lexer (cc->lexText), agrandi a la demande: aucun lexeme n'est tronque
+static inline void lexPush(int c){
+    if(cc->lexLen+1 >= cc->lexCap){
+        cc->lexCap = cc->lexCap ? cc->lexCap*2 : 256;
+        cc->lexText = realloc(cc->lexText,cc->lexCap);
+        if(!cc->lexText){
+            fatal("memoire insuffisante");
+        }
+    }
+    cc->lexText[cc->lexLen++] = (char)c;
+}
+
+static inline const char *lexIntern(){
+    cc->lexText[cc->lexLen] = 0;
+    return intern(cc->lexText,cc->lexLen);
 }
 
 Token nextToken(){
@@ -150,95 +698,72 @@ Token nextToken(){
     int c;
     do { c = nextChar(); } while(isspace(c));
 
-    t.line=line; t.col=col; t.text[0]=0;
+    t.line=cc->line; t.col=cc->col; t.text="";
+    cc->lexLen=0;
 
     if(c==EOF){ t.type=TOK_EOF; return t; }
 
     if(isalpha(c)){
-        int i=0;
         while(isalnum(c)){
-            t.text[i++]=c;
+            lexPush(c);
             c=nextChar();
         }
-        t.text[i]=0;
         unreadChar(c);
+        cc->lexText[cc->lexLen]=0;
 
-        if(!strcmp(t.text,"DEBUT")) t.type=TOK_DEBUT;
-        else if(!strcmp(t.text,"FIN")) t.type=TOK_FIN;
-        else if(!strcmp(t.text,"INT")) t.type=TOK_INT;
-        else if(!strcmp(t.text,"CHAR")) t.type=TOK_CHAR;
-        else if(!strcmp(t.text,"FLOAT")) t.type=TOK_FLOAT;
-        else if(!strcmp(t.text,"TABLE")) t.type=TOK_TABLE;
-        else if(!strcmp(t.text,"FONCTION")) t.type=TOK_FONCTION;
-        else if(!strcmp(t.text,"FINFONCTION")) t.type=TOK_FINFONCTION;
-        else if(!strcmp(t.text,"RETOURNER")) t.type=TOK_RETOURNER;
-        else if(!strcmp(t.text,"ECRIRE")) t.type=TOK_ECRIRE;
-        else if(!strcmp(t.text,"LIRE")) t.type=TOK_LIRE;
-        else if(!strcmp(t.text,"POUR")) t.type=TOK_POUR;
-        else if(!strcmp(t.text,"FINPOUR")) t.type=TOK_FINPOUR;
-        else if(!strcmp(t.text,"TANTQUE")) t.type=TOK_TANTQUE;
-        else if(!strcmp(t.text,"FINTANTQUE")) t.type=TOK_FINTANTQUE;
-        else if(!strcmp(t.text,"REPETER")) t.type=TOK_REPETER;
-        else if(!strcmp(t.text,"SI")) t.type=TOK_SI;
-        else if(!strcmp(t.text,"ALORS")) t.type=TOK_ALORS;
-        else if(!strcmp(t.text,"SINON")) t.type=TOK_SINON;
-        else if(!strcmp(t.text,"FINSI")) t.type=TOK_FINSI;
-        else if(!strcmp(t.text,"DE")) t.type=TOK_DE;
-        else if(!strcmp(t.text,"A")) t.type=TOK_A;
-        else t.type=TOK_ID;
+        t.type = lexLinear ? keywordLinear(cc->lexText) : keywordType(cc->lexText,(int)cc->lexLen);
+        t.text = lexIntern();
         return t;
     }
 
     if(c=='\''){
         c=nextChar();
-        t.text[0] = (char)c;
-        t.text[1] = 0;
-        if(nextChar() != '\'')
-            fprintf(stderr,"ERREUR LEXICALE: caractere literal mal forme\n"), exit(1);
+        lexPush(c);
+        t.text = lexIntern();
+        if(nextChar() != '\''){
+            if(!errorsJson) fprintf(cc->diag,"ERREUR LEXICALE: caractere literal mal forme\n");
+            lexicalError(t.line,t.col,"caractere literal mal forme",t.text);
+        }
         t.type = TOK_CHAR_LIT;
         return t;
     }
 
     if(c == '"') {
-        int i = 0;
         c = nextChar();
         while(c != '"' && c != EOF) {
-            t.text[i++] = (char)c;
+            lexPush(c);
             c = nextChar();
         }
         if(c != '"') {
-            fprintf(stderr, "ERREUR LEXICALE: chaîne non terminée\n");
-            exit(1);
+            if(!errorsJson) fprintf(cc->diag, "ERREUR LEXICALE: chaîne non terminée\n");
+            lexicalError(t.line,t.col,"chaine non terminee","\"");
         }
-        t.text[i] = 0;
+        t.text = lexIntern();
         t.type = TOK_STRING;
         return t;
     }
 
     if(isdigit(c)){
-        int i=0;
         int isFloat=0;
         while(isdigit(c) || (c=='.' && !isFloat)){
             if(c=='.') isFloat=1;
-            t.text[i++]=c;
+            lexPush(c);
             c=nextChar();
         }
-        t.text[i]=0;
         unreadChar(c);
+        t.text = lexIntern();
         t.type = isFloat ? TOK_REEL : TOK_NUM;
         return t;
     }
 
-    t.text[0]=c; t.text[1]=0;
-
     if(c == '=') {
         c = nextChar();
         if(c == '=') {
-            t.text[1] = '=';
-            t.text[2] = 0;
+            t.text = "==";
             t.type = TOK_EGAL;
         } else {
             unreadChar(c);
+            t.text = "=";
             t.type = TOK_AFFECT;
         }
         return t;
@@ -246,24 +771,26 @@ Token nextToken(){
     else if(c == '!') {
         c = nextChar();
         if(c == '=') {
-            t.text[1] = '=';
-            t.text[2] = 0;
+            t.text = "!=";
             t.type = TOK_DIFF;
             return t;
         } else {
             unreadChar(c);
-            fprintf(stderr, "ERREUR LEXICALE: '!' non suivi de '='\n");
-            exit(1);
+            if(!errorsJson) fprintf(cc->diag, "ERREUR LEXICALE: '!' non suivi de '='\n");
+            lexicalError(t.line,t.col,"'!' non suivi de '='","!");
+            t.text = "!=";
+            t.type = TOK_DIFF;
+            return t;
         }
     }
     else if(c == '<') {
         c = nextChar();
         if(c == '=') {
-            t.text[1] = '=';
-            t.text[2] = 0;
+            t.text = "<=";
             t.type = TOK_INFEG;
         } else {
             unreadChar(c);
+            t.text = "<";
             t.type = TOK_INF;
         }
         return t;
@@ -271,676 +798,6110 @@ Token nextToken(){
     else if(c == '>') {
         c = nextChar();
         if(c == '=') {
-            t.text[1] = '=';
-            t.text[2] = 0;
+            t.text = ">=";
             t.type = TOK_SUPEG;
         } else {
             unreadChar(c);
+            t.text = ">";
             t.type = TOK_SUP;
         }
         return t;
     }
 
     switch(c){
-        case '[': t.type=TOK_CO; break;
-        case ']': t.type=TOK_CF; break;
-        case '~': t.type=TOK_AFFECT; break;
-        case '+': t.type=TOK_PLUS; break;
-        case '-': t.type=TOK_MOINS; break;
-        case '*': t.type=TOK_MUL; break;
-        case '/': t.type=TOK_DIV; break;
-        case '(': t.type=TOK_PO; break;
-        case ')': t.type=TOK_PF; break;
-        case ',': t.type=TOK_VIRGULE; break;
-        default:
-            fprintf(stderr,
-                "ERREUR LEXICALE [%d:%d] Caractere inconnu -> '%c'\n",
-                line,col,c);
-            exit(1);
+        case '[': t.type=TOK_CO; t.text="["; break;
+        case ']': t.type=TOK_CF; t.text="]"; break;
+        case '~': t.type=TOK_AFFECT; t.text="~"; break;
+        case '+': t.type=TOK_PLUS; t.text="+"; break;
+        case '-': t.type=TOK_MOINS; t.text="-"; break;
+        case '*': t.type=TOK_MUL; t.text="*"; break;
+        case '/': t.type=TOK_DIV; t.text="/"; break;
+        case '(': t.type=TOK_PO; t.text="("; break;
+        case ')': t.type=TOK_PF; t.text=")"; break;
+        case ',': t.type=TOK_VIRGULE; t.text=","; break;
+        default: {
+            char bad = (char)c;
+            if(!errorsJson)
+                fprintf(cc->diag,
+                    "ERREUR LEXICALE [%d:%d] Caractere inconnu -> '%c'\n",
+                    cc->line,cc->col,c);
+            lexicalError(cc->line,cc->col,"Caractere inconnu",intern(&bad,1));
+            return nextToken();
+        }
     }
     return t;
 }
 
+/* Arbre syntaxique: le parseur construit l'arbre, l'analyse semantique le
+   type, puis la generation de code le parcourt. Les genres de noeuds suivent
+   les tokens du pseudo-code. */
+typedef enum {
+    N_PROGRAMME, N_FONCTION, N_DECL,
+    N_AFFECT, N_RETOURNER, N_ECRIRE, N_LIRE,
+    N_POUR, N_TANTQUE, N_REPETER, N_SI,
+    N_NUM, N_REEL, N_CHAR_LIT, N_STRING,
+    N_VAR, N_INDEX, N_APPEL, N_BINOP
+} NodeKind;
+
+/* Fils selon le genre:
+   N_PROGRAMME  a=fonctions  b=declarations  c=instructions
+   N_FONCTION   a=parametres b=declarations  c=instructions
+   N_AFFECT     a=cible (N_VAR/N_INDEX)      b=expression
+   N_LIRE       a=cible     N_ECRIRE/N_RETOURNER a=expression
+   N_POUR       a=variable  b=debut  c=fin   d=corps
+                (--simd: sym, op = variable et operateur de reduction)
+   N_TANTQUE, N_REPETER     a=condition      d=corps
+   N_SI         a=condition b=alors  c=sinon (un N_SI seul si elseIf)
+   N_INDEX      a=indice    N_APPEL a=arguments
+   N_BINOP      a=gauche    b=droite, op=token de l'operateur */
+typedef struct Node Node;
+struct Node {
+    unsigned char kind;   // NodeKind
+    unsigned char op;     // TokenType de l'operateur (N_BINOP)
+    unsigned char vtype;  // type calcule par l'analyse (ou declare pour N_DECL)
+    unsigned char paren;  // expression parenthesee dans la source
+    unsigned char elseIf; // N_SI introduit par SINON SI
+    unsigned char simd;   // N_POUR vectorisable (--simd)
+    unsigned char parallel; // N_POUR repartie entre les coeurs (--parallel)
+    int arraySize;        // N_DECL
+    Token tok;            // nom, litteral ou mot-cle d'origine
+    Symbol *sym;          // symbole resolu par l'analyse
+    Node *a, *b, *c, *d;
+    Node *next;           // element suivant d'une liste
+};
+
+Node *newNode(NodeKind kind, Token tok){
+    Node *n = arenaAlloc(&cc->arena,sizeof(Node));
+    memset(n,0,sizeof(Node));
+    n->kind=kind;
+    n->tok=tok;
+    return n;
+}
+
+// Lexeme suivant pour le parseur; en mode flux avec --stats, chaque appel au lexer est chronometre
+Token advance(){
+    cc->stats.tokens++;
+    cc->prevLine = cc->current.line;
+    if(!statsMode || !streamMode) return nextToken();
+    double t0 = nowSeconds();
+    Token t = nextToken();
+    cc->stats.lex += nowSeconds()-t0;
+    return t;
+}
+
 void eat(TokenType t){
-    if(current.type!=t)
-        syn_error(current,"Token inattendu");
-    current=nextToken();
+    if(cc->current.type!=t)
+        syn_error(cc->current,"Token inattendu");
+    cc->current=advance();
 }
 
-void EXPR_COMPLETE(VarType *outType);
-void INSTRUCTION();
+Node *EXPR_COMPLETE();
+Node *INSTRUCTION();
 
-void FACT(VarType *outType){
-    if(current.type==TOK_PO){
+Node *FACT(){
+    Token t = cc->current;
+    if(cc->current.type==TOK_PO){
         // Expression entre parenthèses
-        fprintf(out,"(");
         eat(TOK_PO);
-        EXPR_COMPLETE(outType);
+        Node *n = EXPR_COMPLETE();
         eat(TOK_PF);
-        fprintf(out,")");
+        n->paren = 1;
+        return n;
     }
-    else if(current.type==TOK_ID){
-        char name[64];
-        strcpy(name,current.text);
+    else if(cc->current.type==TOK_ID){
         eat(TOK_ID);
 
-        if(current.type==TOK_PO){
-            int argCount=0;
-            int idx = findSymbol(name,SYM_FUNC);
-            if(idx==-1)
-                sem_error(current,"Fonction non declaree");
-
-            fprintf(out,"%s(",name);
+        if(cc->current.type==TOK_PO){
+            Node *n = newNode(N_APPEL,t);
+            Node **tail = &n->a;
             eat(TOK_PO);
-
-            if(current.type!=TOK_PF){
-                VarType dummy;
-                EXPR_COMPLETE(&dummy);
-
-                if(argCount < symtab[idx].paramCount){
-                    VarType paramType = symtab[idx].paramTypes[argCount];
-                    if(dummy != paramType)
-                        sem_error(current,"Type de parametre incorrect");
-                }
-
-                argCount++;
-                while(current.type==TOK_VIRGULE){
-                    fprintf(out,", ");
+            if(cc->current.type!=TOK_PF){
+                *tail = EXPR_COMPLETE();
+                tail = &(*tail)->next;
+                while(cc->current.type==TOK_VIRGULE){
                     eat(TOK_VIRGULE);
-                    EXPR_COMPLETE(&dummy);
-
-                    if(argCount < symtab[idx].paramCount){
-                        VarType paramType = symtab[idx].paramTypes[argCount];
-                        if(dummy != paramType)
-                            sem_error(current,"Type de parametre incorrect");
-                    }
-
-                    argCount++;
+                    *tail = EXPR_COMPLETE();
+                    tail = &(*tail)->next;
                 }
             }
             eat(TOK_PF);
-            fprintf(out,")");
-
-            if(argCount!=symtab[idx].paramCount)
-                sem_error(current,"Nombre de parametres incorrect");
-            *outType = getSymbolType(idx);
-        }
-        else if(current.type==TOK_CO){
-            int idx = findSymbol(name,SYM_VAR);
-            if(idx==-1)
-                sem_error(current,"Variable non declaree");
-            if(symtab[idx].arraySize==0)
-                sem_error(current,"Acces tableau sur variable scalaire");
+            return n;
+        }
+        else if(cc->current.type==TOK_CO){
+            Node *n = newNode(N_INDEX,t);
             eat(TOK_CO);
-            fprintf(out,"%s[",name);
-            VarType idxType;
-            EXPR_COMPLETE(&idxType);
-            if(idxType != TYPE_INT)
-                sem_error(current,"Indice de tableau doit etre de type INT");
+            n->a = EXPR_COMPLETE();
             eat(TOK_CF);
-            fprintf(out,"]");
-            *outType = getSymbolType(idx);
-        }
-        else{
-            int idx = findSymbol(name,SYM_VAR);
-            if(idx==-1)
-                sem_error(current,"Variable non declaree");
-            *outType = getSymbolType(idx);
-            fprintf(out,"%s",name);
+            return n;
         }
+        return newNode(N_VAR,t);
     }
-    else if(current.type==TOK_NUM){
-        fprintf(out,"%s",current.text);
+    else if(cc->current.type==TOK_NUM){
         eat(TOK_NUM);
-        *outType = TYPE_INT;
+        return newNode(N_NUM,t);
     }
-    else if(current.type==TOK_REEL){
-        fprintf(out,"%s",current.text);
+    else if(cc->current.type==TOK_REEL){
         eat(TOK_REEL);
-        *outType = TYPE_FLOAT;
+        return newNode(N_REEL,t);
     }
-    else if(current.type==TOK_CHAR_LIT){
-        fprintf(out,"'%s'",current.text);
+    else if(cc->current.type==TOK_CHAR_LIT){
         eat(TOK_CHAR_LIT);
-        *outType = TYPE_CHAR;
+        return newNode(N_CHAR_LIT,t);
     }
-    else syn_error(current,"Facteur invalide");
+    syn_error(cc->current,"Facteur invalide");
+    return NULL;
 }
 
-void TERM(VarType *outType){
-    VarType t1;
-    FACT(&t1);
-    while(current.type==TOK_MUL||current.type==TOK_DIV){
-        fprintf(out," %c ",current.type==TOK_MUL?'*':'/');
-        eat(current.type);
-        VarType t2;
-        FACT(&t2);
-        if(t1 != t2)
-            sem_error(current,"Operation entre types differents (mul/div)");
-        t1 = t2;
-    }
-    *outType = t1;
+Node *binop(Node *left){
+    Node *n = newNode(N_BINOP,cc->current);
+    n->op = cc->current.type;
+    n->a = left;
+    eat(cc->current.type);
+    return n;
 }
 
-void EXPR(VarType *outType){
-    VarType t1;
-    TERM(&t1);
-    while(current.type==TOK_PLUS||current.type==TOK_MOINS){
-        fprintf(out," %c ",current.type==TOK_PLUS?'+':'-');
-        eat(current.type);
-        VarType t2;
-        TERM(&t2);
-        if(t1 != t2)
-            sem_error(current,"Operation entre types differents (add/sub)");
-        t1 = t2;
+Node *TERM(){
+    Node *n = FACT();
+    while(cc->current.type==TOK_MUL||cc->current.type==TOK_DIV){
+        n = binop(n);
+        n->b = FACT();
     }
-    *outType = t1;
+    return n;
 }
 
-void EXPR_COMPLETE(VarType *outType){
-    VarType t1;
-    EXPR(&t1);
+Node *EXPR(){
+    Node *n = TERM();
+    while(cc->current.type==TOK_PLUS||cc->current.type==TOK_MOINS){
+        n = binop(n);
+        n->b = TERM();
+    }
+    return n;
+}
 
-    if(current.type == TOK_EGAL || current.type == TOK_DIFF ||
-       current.type == TOK_INF || current.type == TOK_SUP ||
-       current.type == TOK_INFEG || current.type == TOK_SUPEG) {
+int isComparison(TokenType op){
+    return op == TOK_EGAL || op == TOK_DIFF ||
+           op == TOK_INF || op == TOK_SUP ||
+           op == TOK_INFEG || op == TOK_SUPEG;
+}
 
-        TokenType op = current.type;
-        const char* opStr;
-        switch(op){
-            case TOK_EGAL: opStr = "=="; break;
-            case TOK_DIFF: opStr = "!="; break;
-            case TOK_INF: opStr = "<"; break;
-            case TOK_SUP: opStr = ">"; break;
-            case TOK_INFEG: opStr = "<="; break;
-            case TOK_SUPEG: opStr = ">="; break;
-            default: opStr = "==";
-        }
+Node *EXPR_COMPLETE(){
+    Node *n = EXPR();
+    if(isComparison(cc->current.type)){
+        n = binop(n);
+        n->b = EXPR();
+    }
+    return n;
+}
 
-        fprintf(out," %s ",opStr);
-        eat(current.type);
+// Variable ou element de tableau a gauche d'une affectation ou dans LIRE
+Node *CIBLE(){
+    Token t = cc->current;
+    eat(TOK_ID);
+    if(cc->current.type==TOK_CO){
+        Node *n = newNode(N_INDEX,t);
+        eat(TOK_CO);
+        n->a = EXPR_COMPLETE();
+        eat(TOK_CF);
+        return n;
+    }
+    return newNode(N_VAR,t);
+}
 
-        VarType t2;
-        EXPR(&t2);
+int isTypeToken(TokenType t){
+    return t==TOK_INT || t==TOK_CHAR || t==TOK_FLOAT;
+}
 
-        if(t1 != t2)
-            sem_error(current,"Comparaison entre types differents");
+int isBlockKeyword(TokenType t){
+    return t==TOK_FINSI || t==TOK_SINON || t==TOK_FINPOUR || t==TOK_FINTANTQUE ||
+           t==TOK_FINFONCTION || t==TOK_FIN || t==TOK_DEBUT || t==TOK_FONCTION || t==TOK_EOF;
+}
 
-        *outType = TYPE_INT;
-    } else {
-        *outType = t1;
-    }
+// Debut possible d'une instruction ou d'une declaration
+int startsStatement(TokenType t){
+    return t==TOK_ID || t==TOK_RETOURNER || t==TOK_ECRIRE || t==TOK_LIRE ||
+           t==TOK_TANTQUE || t==TOK_REPETER || t==TOK_POUR || t==TOK_SI ||
+           isTypeToken(t) || t==TOK_TABLE;
 }
 
-void AFFECT(){
-    char name[64];
-    strcpy(name,current.text);
-    int symIdx = findSymbol(name,SYM_VAR);
-    if(symIdx==-1)
-        sem_error(current,"Variable non declaree");
+/* Saute les tokens jusqu'a un mot-cle de bloc, ou une instruction en debut
+   de ligne. Au moins un token est consomme si l'erreur est sur le premier
+   (FINSI egare...), la boucle avance donc toujours. */
+void resync(Token start){
+    if(cc->current.line==start.line && cc->current.col==start.col && cc->current.type!=TOK_EOF)
+        cc->current = advance();
+    while(!isBlockKeyword(cc->current.type) &&
+          !(cc->current.line>cc->prevLine && startsStatement(cc->current.type)))
+        cc->current = advance();
+    if(cc->current.type==TOK_EOF) compileFailed();
+}
 
-    eat(TOK_ID);
-    VarType lhsType;
-    printIndent();
+/* En-tete de bloc abandonne: le corps est saute jusqu'au mot-cle de fin
+   correspondant, consomme, pour que ce dernier ne soit pas signale a son
+   tour. Le TANTQUE d'un REPETER le ferme; SINON SI n'ouvre pas de bloc. */
+void skipBlock(TokenType fin){
+    char repeter[64];
+    int depth = 0;
+    TokenType prev = TOK_EOF;
+    for(;;){
+        TokenType t = cc->current.type;
+        if(t==TOK_EOF) compileFailed();
+        if(t==TOK_FINFONCTION || t==TOK_FIN || t==TOK_DEBUT || t==TOK_FONCTION) return;
+        if(t==TOK_FINSI || t==TOK_FINPOUR || t==TOK_FINTANTQUE ||
+           (t==TOK_TANTQUE && depth>0 && depth<=64 && repeter[depth-1])){
+            if(depth==0){
+                if(t==fin) cc->current = advance();
+                return;   // fin d'un bloc englobant: FINSI manquant
+            }
+            depth--;
+        }
+        else if(t==TOK_REPETER || t==TOK_POUR || t==TOK_TANTQUE || (t==TOK_SI && prev!=TOK_SINON)){
+            if(depth<64) repeter[depth] = t==TOK_REPETER;
+            depth++;
+        }
+        prev = t;
+        cc->current = advance();
+    }
+}
 
-    if(current.type==TOK_CO){
-        if(symtab[symIdx].arraySize==0)
-            sem_error(current,"Acces tableau sur variable scalaire");
-        eat(TOK_CO);
-        fprintf(out,"%s[",name);
-        VarType idxType;
-        EXPR_COMPLETE(&idxType);
-        if(idxType != TYPE_INT)
-            sem_error(current,"Indice de tableau doit etre de type INT");
-        eat(TOK_CF);
-        fprintf(out,"] = ");
-        lhsType = TYPE_INT;
+// Point de reprise du parseur: renvoie NULL si parse() a echoue
+Node *recovering(Node *(*parse)(void)){
+    if(maxErrors<=1) return parse();
+    jmp_buf here, *outer = cc->recover;
+    Token start = cc->current;
+    Node *volatile n = NULL;
+    cc->recover = &here;
+    if(setjmp(here)==0) n = parse();
+    else if(cc->inHeader){
+        cc->inHeader = 0;
+        skipBlock(start.type==TOK_SI ? TOK_FINSI : start.type==TOK_POUR ? TOK_FINPOUR : TOK_FINTANTQUE);
     }
-    else{
-        lhsType = getSymbolType(symIdx);
-        fprintf(out,"%s = ",name);
+    else resync(start);
+    cc->recover = outer;
+    return n;
+}
+
+// Instructions jusqu'a l'un des deux tokens de fin (non consomme)
+Node *BLOC(TokenType fin1, TokenType fin2){
+    Node *head = NULL, **tail = &head;
+    while(cc->current.type!=fin1 && cc->current.type!=fin2){
+        Node *n = recovering(INSTRUCTION);
+        if(n){
+            *tail = n;
+            tail = &n->next;
+        }
     }
+    return head;
+}
 
+Node *AFFECT(){
+    Node *n = newNode(N_AFFECT,cc->current);
+    n->a = CIBLE();
     eat(TOK_AFFECT);
-    VarType rhsType;
-    EXPR_COMPLETE(&rhsType);
-    if(lhsType != rhsType)
-        sem_error(current,"Affectation: types incompatibles");
-    fprintf(out,";\n");
+    n->b = EXPR_COMPLETE();
+    return n;
 }
 
-void RETOURNER(){
-    if(!inFunction)
-        sem_error(current,"RETOURNER hors fonction");
-
+Node *RETOURNER(){
+    Node *n = newNode(N_RETOURNER,cc->current);
     eat(TOK_RETOURNER);
-    printIndent();
-    fprintf(out,"return ");
-    VarType dummy;
-    EXPR_COMPLETE(&dummy);
-    fprintf(out,";\n");
+    n->a = EXPR_COMPLETE();
+    return n;
 }
 
-void ECRIRE(){
+Node *ECRIRE(){
+    Node *n = newNode(N_ECRIRE,cc->current);
     eat(TOK_ECRIRE);
-    printIndent();
 
-    if(current.type == TOK_STRING) {
-        fprintf(out, "printf(\"%s\\n\");\n", current.text);
+    if(cc->current.type == TOK_STRING) {
+        n->a = newNode(N_STRING,cc->current);
         eat(TOK_STRING);
     } else {
-        VarType exprType;
-
-        char *exprBuf = NULL;
-        size_t exprLen = 0;
-        FILE *mem = open_memstream(&exprBuf, &exprLen);
-        FILE *saveOut = out;
-        out = mem;
-        EXPR_COMPLETE(&exprType);
-        fflush(mem);
-        fclose(mem);
-        out = saveOut;
-
-        const char *fmt = (exprType==TYPE_INT)?"%d":(exprType==TYPE_FLOAT)?"%f":"%c";
-        fprintf(out,"printf(\"%s\\n\", %s);\n", fmt, exprBuf ? exprBuf : "");
-        if(exprBuf) free(exprBuf);
+        n->a = EXPR_COMPLETE();
     }
+    return n;
 }
 
-void LIRE(){
+Node *LIRE(){
+    Node *n = newNode(N_LIRE,cc->current);
     eat(TOK_LIRE);
     eat(TOK_PO);
-
-    char name[64];
-    strcpy(name,current.text);
-    int symIdx = findSymbol(name,SYM_VAR);
-    if(symIdx==-1)
-        sem_error(current,"Variable non declaree");
-    eat(TOK_ID);
-
-    VarType vtype;
-    printIndent();
-
-    if(current.type==TOK_CO){
-        if(symtab[symIdx].arraySize==0)
-            sem_error(current,"Acces tableau sur variable scalaire");
-        eat(TOK_CO);
-        fprintf(out,"scanf(\"%%d\", &%s[",name);
-        VarType idxType;
-        EXPR_COMPLETE(&idxType);
-        if(idxType != TYPE_INT)
-            sem_error(current,"Indice de tableau doit etre de type INT");
-        eat(TOK_CF);
-        fprintf(out,"]);\n");
-        vtype = TYPE_INT;
-    }
-    else{
-        vtype = getSymbolType(symIdx);
-        const char *fmt = (vtype==TYPE_INT)?"%d":(vtype==TYPE_FLOAT)?"%f":" %c";
-        fprintf(out,"scanf(\"%s\", &%s);\n", fmt, name);
-    }
-
+    n->a = CIBLE();
     eat(TOK_PF);
+    return n;
 }
 
-void TANTQUE_BOUCLE(){
+Node *TANTQUE_BOUCLE(){
+    Node *n = newNode(N_TANTQUE,cc->current);
     eat(TOK_TANTQUE);
-    printIndent();
-    fprintf(out,"while(");
-    VarType condType;
-    EXPR_COMPLETE(&condType);
-    fprintf(out,"){\n");
-    indent++;
-    while(current.type!=TOK_FINTANTQUE)
-        INSTRUCTION();
+    cc->inHeader = 1;
+    n->a = EXPR_COMPLETE();
+    cc->inHeader = 0;
+    n->d = BLOC(TOK_FINTANTQUE,TOK_FINTANTQUE);
     eat(TOK_FINTANTQUE);
-    indent--;
-    printIndent();
-    fprintf(out,"}\n");
+    return n;
 }
 
-void REPETER_BOUCLE(){
+Node *REPETER_BOUCLE(){
+    Node *n = newNode(N_REPETER,cc->current);
     eat(TOK_REPETER);
-    printIndent();
-    fprintf(out,"do{\n");
-    indent++;
-    while(current.type!=TOK_TANTQUE)
-        INSTRUCTION();
+    n->d = BLOC(TOK_TANTQUE,TOK_TANTQUE);
     eat(TOK_TANTQUE);
-    printIndent();
-    fprintf(out,"} while(");
-    VarType condType;
-    EXPR_COMPLETE(&condType);
-    fprintf(out,");\n");
+    n->a = EXPR_COMPLETE();
+    return n;
 }
 
-void POUR_BOUCLE(){
+Node *POUR_BOUCLE(){
+    Node *n = newNode(N_POUR,cc->current);
     eat(TOK_POUR);
+    cc->inHeader = 1;
 
-    if(current.type!=TOK_ID)
-        syn_error(current,"Identifiant attendu apres POUR");
-    char var[64];
-    strcpy(var,current.text);
-    int idx = findSymbol(var,SYM_VAR);
-    if(idx==-1)
-        sem_error(current,"Variable de boucle non declaree");
-    if(getSymbolType(idx)!=TYPE_INT)
-        sem_error(current,"Variable de boucle POUR doit etre de type INT");
+    if(cc->current.type!=TOK_ID)
+        syn_error(cc->current,"Identifiant attendu apres POUR");
+    n->a = newNode(N_VAR,cc->current);
     eat(TOK_ID);
 
     eat(TOK_DE);
-
-    printIndent();
-    fprintf(out,"for(%s = ",var);
-    VarType tDebut;
-    EXPR_COMPLETE(&tDebut);
-    if(tDebut!=TYPE_INT)
-        sem_error(current,"Borne de debut POUR doit etre de type INT");
-
-    fprintf(out,"; %s <= ",var);
+    n->b = EXPR_COMPLETE();
     eat(TOK_A);
-    VarType tFin;
-    EXPR_COMPLETE(&tFin);
-    if(tFin!=TYPE_INT)
-        sem_error(current,"Borne de fin POUR doit etre de type INT");
-    fprintf(out,"; %s++){\n",var);
-
-    indent++;
-    while(current.type!=TOK_FINPOUR)
-        INSTRUCTION();
+    n->c = EXPR_COMPLETE();
+    cc->inHeader = 0;
+
+    n->d = BLOC(TOK_FINPOUR,TOK_FINPOUR);
     eat(TOK_FINPOUR);
-    indent--;
-    printIndent();
-    fprintf(out,"}\n");
+    return n;
 }
 
-void SI_CONDITION(){
+Node *SI_CONDITION(){
+    Node *n = newNode(N_SI,cc->current);
     eat(TOK_SI);
-    printIndent();
-    fprintf(out,"if(");
-
-    VarType condType;
-    EXPR_COMPLETE(&condType);
-
+    cc->inHeader = 1;
+    n->a = EXPR_COMPLETE();
     eat(TOK_ALORS);
-    fprintf(out,"){\n");
+    cc->inHeader = 0;
 
-    indent++;
-    while(current.type != TOK_SINON && current.type != TOK_FINSI){
-        INSTRUCTION();
-    }
+    n->b = BLOC(TOK_SINON,TOK_FINSI);
 
-    if(current.type == TOK_SINON){
+    if(cc->current.type == TOK_SINON){
         eat(TOK_SINON);
-        indent--;
-        printIndent();
-        fprintf(out,"} else ");
-
-        if(current.type == TOK_SI){
-            SI_CONDITION();
+        if(cc->current.type == TOK_SI){
+            n->c = SI_CONDITION();
+            n->c->elseIf = 1;
         } else {
-            fprintf(out,"{\n");
-            indent++;
-            while(current.type != TOK_FINSI){
-                INSTRUCTION();
-            }
+            n->c = BLOC(TOK_FINSI,TOK_FINSI);
             eat(TOK_FINSI);
-            indent--;
-            printIndent();
-            fprintf(out,"}\n");
         }
     } else {
         eat(TOK_FINSI);
-        indent--;
-        printIndent();
-        fprintf(out,"}\n");
     }
+    return n;
 }
 
-void INSTRUCTION(){
-    if(current.type==TOK_ID) AFFECT();
-    else if(current.type==TOK_RETOURNER) RETOURNER();
-    else if(current.type==TOK_ECRIRE) ECRIRE();
-    else if(current.type==TOK_LIRE) LIRE();
-    else if(current.type==TOK_TANTQUE) TANTQUE_BOUCLE();
-    else if(current.type==TOK_REPETER) REPETER_BOUCLE();
-    else if(current.type==TOK_POUR) POUR_BOUCLE();
-    else if(current.type==TOK_SI) SI_CONDITION();
-    else syn_error(current,"Instruction inconnue");
+Node *INSTRUCTION(){
+    if(cc->current.type==TOK_ID) return AFFECT();
+    else if(cc->current.type==TOK_RETOURNER) return RETOURNER();
+    else if(cc->current.type==TOK_ECRIRE) return ECRIRE();
+    else if(cc->current.type==TOK_LIRE) return LIRE();
+    else if(cc->current.type==TOK_TANTQUE) return TANTQUE_BOUCLE();
+    else if(cc->current.type==TOK_REPETER) return REPETER_BOUCLE();
+    else if(cc->current.type==TOK_POUR) return POUR_BOUCLE();
+    else if(cc->current.type==TOK_SI) return SI_CONDITION();
+    syn_error(cc->current,"Instruction inconnue");
+    return NULL;
 }
 
-void FONCTION_DECL(){
-    eat(TOK_FONCTION);
+VarType TYPE(){
+    VarType vtype;
+    if(cc->current.type==TOK_INT) vtype=TYPE_INT;
+    else if(cc->current.type==TOK_CHAR) vtype=TYPE_CHAR;
+    else vtype=TYPE_FLOAT;
+    eat(cc->current.type);
+    return vtype;
+}
 
-    char fname[64];
-    strcpy(fname,current.text);
-    eat(TOK_ID);
+Node *DECLARATION(){
+    VarType vtype;
+    int isTable = 0;
+
+    if(cc->current.type==TOK_TABLE){
+        eat(TOK_TABLE);
+        isTable = 1;
+        if(!isTypeToken(cc->current.type))
+            syn_error(cc->current,"Type de tableau attendu (INT, FLOAT, CHAR) apres TABLE");
+    }
+    vtype = TYPE();
 
-    int paramCount=0;
-    VarType paramTypes[10];
-    char paramNames[10][64];
-    int paramStartIdx = symCount;
+    Node *n = newNode(N_DECL,cc->current);
+    n->vtype = vtype;
+    eat(TOK_ID);
 
-    eat(TOK_PO);
-    if(current.type==TOK_INT||current.type==TOK_CHAR||current.type==TOK_FLOAT){
-        VarType ptype;
-        if(current.type==TOK_INT){
-            eat(TOK_INT);
-            ptype=TYPE_INT;
+    if(isTable || cc->current.type==TOK_CO){
+        if(cc->current.type==TOK_CO){
+            eat(TOK_CO);
+            if(cc->current.type!=TOK_NUM)
+                syn_error(cc->current,"Taille de tableau doit etre une constante");
+            n->arraySize = atoi(cc->current.text);
+            eat(TOK_NUM);
+            eat(TOK_CF);
         }
-        else if(current.type==TOK_CHAR){
-            eat(TOK_CHAR);
-            ptype=TYPE_CHAR;
+        else if(isTable){
+            syn_error(cc->current,"Crochets attendus pour declaration de tableau");
         }
-        else{
-            eat(TOK_FLOAT);
-            ptype=TYPE_FLOAT;
+    }
+    return n;
+}
+
+// Declarations en tete de fonction ou de DEBUT
+Node *DECLARATIONS(){
+    Node *head = NULL, **tail = &head;
+    while(isTypeToken(cc->current.type) || cc->current.type==TOK_TABLE){
+        Node *n = recovering(DECLARATION);
+        if(n){
+            *tail = n;
+            tail = &n->next;
         }
+    }
+    return head;
+}
 
-        strcpy(paramNames[paramCount],current.text);
-        paramTypes[paramCount]=ptype;
+Node *FONCTION_DECL(){
+    eat(TOK_FONCTION);
+    Node *n = newNode(N_FONCTION,cc->current);
+    eat(TOK_ID);
 
-        addSymbolTyped(current.text,SYM_VAR,0,ptype,0);
-        paramCount++;
-        eat(TOK_ID);
+    Node **tail = &n->a;
+    eat(TOK_PO);
+    if(isTypeToken(cc->current.type)){
+        for(;;){
+            VarType ptype = TYPE();
+            Node *p = newNode(N_DECL,cc->current);
+            p->vtype = ptype;
+            eat(TOK_ID);
+            *tail = p;
+            tail = &p->next;
 
-        while(current.type==TOK_VIRGULE){
+            if(cc->current.type!=TOK_VIRGULE) break;
             eat(TOK_VIRGULE);
+            if(!isTypeToken(cc->current.type))
+                syn_error(cc->current,"Type de parametre attendu");
+        }
+    }
+    eat(TOK_PF);
 
-            if(current.type==TOK_INT){
-                eat(TOK_INT);
-                ptype=TYPE_INT;
-            }
-            else if(current.type==TOK_CHAR){
-                eat(TOK_CHAR);
-                ptype=TYPE_CHAR;
-            }
-            else if(current.type==TOK_FLOAT){
-                eat(TOK_FLOAT);
-                ptype=TYPE_FLOAT;
-            }
-            else syn_error(current,"Type de parametre attendu");
+    n->b = DECLARATIONS();
+    n->c = BLOC(TOK_FINFONCTION,TOK_FINFONCTION);
+    eat(TOK_FINFONCTION);
+    return n;
+}
 
-            strcpy(paramNames[paramCount],current.text);
-            paramTypes[paramCount]=ptype;
+Node *PROGRAM(){
+    Node *n = newNode(N_PROGRAMME,cc->current);
 
-            addSymbolTyped(current.text,SYM_VAR,0,ptype,0);
-            paramCount++;
-            eat(TOK_ID);
-        }
+    Node **tail = &n->a;
+    while(cc->current.type==TOK_FONCTION){
+        *tail = FONCTION_DECL();
+        tail = &(*tail)->next;
     }
-    eat(TOK_PF);
 
-    addFunctionSymbol(fname,paramCount,paramTypes);
+    eat(TOK_DEBUT);
+    n->b = DECLARATIONS();
+    n->c = BLOC(TOK_FIN,TOK_FIN);
+    eat(TOK_FIN);
+    return n;
+}
+
+/* ---------- Analyse semantique ---------- */
+
+VarType analyseExpr(Node *n);
+
+// Resout une variable ou un element de tableau; renvoie le type de la valeur designee
+VarType analyseCible(Node *n){
+    n->sym = findSymbol(n->tok.text,SYM_VAR);
+    if(!n->sym)
+        sem_error(n->tok,"Variable non declaree");
 
-    fprintf(out,"int %s(",fname);
-    for(int i=0;i<paramCount;i++){
-        if(i) fprintf(out,", ");
-        fprintf(out,"%s %s", typeToCStr(paramTypes[i]), paramNames[i]);
+    if(n->kind==N_INDEX){
+        if(n->sym->arraySize==0)
+            sem_error(n->tok,"Acces tableau sur variable scalaire");
+        if(analyseExpr(n->a) != TYPE_INT)
+            sem_error(n->a->tok,"Indice de tableau doit etre de type INT");
     }
-    fprintf(out,"){\n");
+    n->vtype = getSymbolType(n->sym);
+    return n->vtype;
+}
 
-    inFunction=1;
-    currentScope=1;
-    indent++;
+VarType analyseExpr(Node *n){
+    switch(n->kind){
+        case N_NUM: n->vtype = TYPE_INT; break;
+        case N_REEL: n->vtype = TYPE_FLOAT; break;
+        case N_CHAR_LIT: n->vtype = TYPE_CHAR; break;
 
-    while(current.type==TOK_INT||current.type==TOK_CHAR||current.type==TOK_FLOAT||current.type==TOK_TABLE){
-        VarType vtype;
-        int isTable = 0;
+        case N_VAR:
+        case N_INDEX:
+            analyseCible(n);
+            break;
 
-        if(current.type==TOK_INT){
-            eat(TOK_INT);
-            vtype=TYPE_INT;
-        }
-        else if(current.type==TOK_CHAR){
-            eat(TOK_CHAR);
-            vtype=TYPE_CHAR;
-        }
-        else if(current.type==TOK_FLOAT){
-            eat(TOK_FLOAT);
-            vtype=TYPE_FLOAT;
-        }
-        else{
-            eat(TOK_TABLE);
-            isTable = 1;
+        case N_APPEL: {
+            n->sym = findSymbol(n->tok.text,SYM_FUNC);
+            if(!n->sym && cc->streamDecl)
+                sem_error(n->tok,"Fonction non declaree (source en flux: appel en avant impossible)");
+            if(!n->sym)
+                sem_error(n->tok,"Fonction non declaree");
+            if(n->sym->slot > cc->currentFunction) cc->forwardCalls = 1;
 
-            if(current.type==TOK_INT){
-                eat(TOK_INT);
-                vtype=TYPE_INT;
-            }
-            else if(current.type==TOK_CHAR){
-                eat(TOK_CHAR);
-                vtype=TYPE_CHAR;
-            }
-            else if(current.type==TOK_FLOAT){
-                eat(TOK_FLOAT);
-                vtype=TYPE_FLOAT;
+            int argCount = 0;
+            for(Node *arg=n->a;arg;arg=arg->next){
+                VarType t = analyseExpr(arg);
+                if(argCount < n->sym->paramCount && t != n->sym->paramTypes[argCount])
+                    sem_error(arg->tok,"Type de parametre incorrect");
+                argCount++;
             }
-            else syn_error(current,"Type de tableau attendu (INT, FLOAT, CHAR) apres TABLE");
+            if(argCount!=n->sym->paramCount)
+                sem_error(n->tok,"Nombre de parametres incorrect");
+            n->vtype = getSymbolType(n->sym);
+            break;
         }
 
-        char name[64];
-        strcpy(name,current.text);
-        eat(TOK_ID);
+        case N_BINOP: {
+            VarType t1 = analyseExpr(n->a);
+            VarType t2 = analyseExpr(n->b);
+            if(isComparison(n->op)){
+                if(t1 != t2)
+                    sem_error(n->tok,"Comparaison entre types differents");
+                n->vtype = TYPE_INT;
+            } else {
+                if(t1 != t2)
+                    sem_error(n->tok,(n->op==TOK_MUL||n->op==TOK_DIV) ?
+                        "Operation entre types differents (mul/div)" :
+                        "Operation entre types differents (add/sub)");
+                n->vtype = t1;
+            }
+            break;
+        }
+
+        default:
+            syn_error(n->tok,"Facteur invalide");
+    }
+    return n->vtype;
+}
+
+void analyseBloc(Node *list);
+
+void analyseInstr(Node *n){
+    switch(n->kind){
+        case N_AFFECT:
+            if(analyseCible(n->a) != analyseExpr(n->b))
+                sem_error(n->tok,"Affectation: types incompatibles");
+            break;
+
+        case N_RETOURNER:
+            if(!cc->inFunction)
+                sem_error(n->tok,"RETOURNER hors fonction");
+            analyseExpr(n->a);
+            break;
+
+        case N_ECRIRE:
+            if(n->a->kind!=N_STRING) analyseExpr(n->a);
+            break;
+
+        case N_LIRE:
+            analyseCible(n->a);
+            break;
+
+        case N_POUR:
+            n->a->sym = findSymbol(n->a->tok.text,SYM_VAR);
+            if(!n->a->sym)
+                sem_error(n->a->tok,"Variable de boucle non declaree");
+            if(getSymbolType(n->a->sym)!=TYPE_INT)
+                sem_error(n->a->tok,"Variable de boucle POUR doit etre de type INT");
+            n->a->vtype = TYPE_INT;
+            if(analyseExpr(n->b)!=TYPE_INT)
+                sem_error(n->b->tok,"Borne de debut POUR doit etre de type INT");
+            if(analyseExpr(n->c)!=TYPE_INT)
+                sem_error(n->c->tok,"Borne de fin POUR doit etre de type INT");
+            analyseBloc(n->d);
+            break;
+
+        case N_TANTQUE:
+        case N_REPETER:
+            analyseExpr(n->a);
+            analyseBloc(n->d);
+            break;
+
+        case N_SI:
+            analyseExpr(n->a);
+            analyseBloc(n->b);
+            analyseBloc(n->c);
+            break;
+
+        default:
+            syn_error(n->tok,"Instruction inconnue");
+    }
+}
+
+// Point de reprise de l'analyse: une instruction fautive est abandonnee
+void analyseRecovering(void (*analyse)(Node*), Node *n){
+    if(maxErrors<=1){
+        analyse(n);
+        return;
+    }
+    jmp_buf here, *outer = cc->recover;
+    cc->recover = &here;
+    if(setjmp(here)==0) analyse(n);
+    cc->recover = outer;
+}
+
+void analyseBloc(Node *list){
+    for(Node *n=list;n;n=n->next)
+        analyseRecovering(analyseInstr,n);
+}
+
+void analyseDecl(Node *d){
+    d->sym = addSymbolTyped(d->tok,SYM_VAR,0,d->vtype,d->arraySize);
+}
+
+void analyseDecls(Node *list){
+    for(Node *d=list;d;d=d->next)
+        analyseRecovering(analyseDecl,d);
+}
+
+/* Pre-passe: toutes les signatures sont declarees avant l'analyse des corps,
+   un appel peut donc viser une fonction definie plus loin. 'slot' garde
+   l'ordre de definition. */
+void declareFonction(Node *f, int index){
+    int paramCount = 0;
+    for(Node *p=f->a;p;p=p->next) paramCount++;
+
+    VarType *types = arenaAlloc(&cc->arena,(paramCount ? paramCount : 1)*sizeof(VarType));
+    int i = 0;
+    for(Node *p=f->a;p;p=p->next) types[i++] = p->vtype;
+    f->sym = addFunctionSymbol(f->tok,paramCount,types);
+    f->sym->slot = index;
+}
+
+void analyseFonction(Node *f){
+    cc->currentFunction = f->sym->slot;
+    pushScope();
+    cc->inFunction=1;
+    analyseDecls(f->a);
+    analyseDecls(f->b);
+    analyseBloc(f->c);
+    cc->inFunction=0;
+    popScope();
+}
+
+void analyseMain(Node *prog){
+    cc->currentFunction = INT_MAX;
+    pushScope();
+    analyseDecls(prog->b);
+    analyseBloc(prog->c);
+    popScope();
+}
+
+void prepareInline(Node *f);
+
+void analyseProgramme(Node *prog){
+    int index = 0;
+    for(Node *f=prog->a;f;f=f->next)
+        declareFonction(f,index++);
+    for(Node *f=prog->a;f;f=f->next){
+        analyseFonction(f);
+        prepareInline(f);
+    }
+    analyseMain(prog);
+}
+
+/* ---------- Optimisations ---------- */
+
+int optLevel = 1;   // -O0 desactive les passes d'optimisation
+int optReport = 0;  // --opt-report: bilan des passes avec les diagnostics
+int simdMode = 0;   // --simd: boucles POUR vectorisables annotees pour gcc
+int parallelMode = 0;   // --parallel: boucles POUR independantes reparties par OpenMP
+
+int isLiteral(Node *n){
+    return n->kind==N_NUM || n->kind==N_REEL || n->kind==N_CHAR_LIT;
+}
+
+long long intValue(Node *n){
+    if(n->kind==N_CHAR_LIT) return (signed char)n->tok.text[0];
+    return strtoll(n->tok.text,NULL,10);
+}
+
+double realValue(Node *n){
+    return strtod(n->tok.text,NULL);
+}
+
+// Pas d'appel de fonction: l'expression peut etre supprimee sans effet observable
+int isPure(Node *n){
+    if(!n) return 1;
+    if(n->kind==N_APPEL) return 0;
+    return isPure(n->a) && isPure(n->b);
+}
+
+// Division ou acces tableau: l'evaluation peut echouer (/0, indice hors bornes)
+int canTrap(Node *e){
+    if(e->kind==N_INDEX || (e->kind==N_BINOP && e->op==TOK_DIV)) return 1;
+    if(e->kind==N_BINOP) return canTrap(e->a) || canTrap(e->b);
+    return 0;
+}
+
+// Remplace le noeud sur place (sa place dans une liste est conservee)
+void replaceNode(Node *n, Node *by){
+    Node *next = n->next;
+    *n = *by;
+    n->next = next;
+}
+
+void setIntLiteral(Node *n, long long v){
+    char buf[32];
+    int len = snprintf(buf,sizeof(buf),"%lld",v);
+    n->kind = N_NUM;
+    n->vtype = TYPE_INT;
+    n->tok.text = intern(buf,len);
+    n->a = n->b = NULL;
+    n->sym = NULL;
+    n->paren = 0;
+}
+
+void setRealLiteral(Node *n, double v){
+    char buf[40];
+    int len = snprintf(buf,sizeof(buf),"%.17g",v);
+    if(!strpbrk(buf,".e")) len += snprintf(buf+len,sizeof(buf)-len,".0");
+    n->kind = N_REEL;
+    n->vtype = TYPE_FLOAT;
+    n->tok.text = intern(buf,len);
+    n->a = n->b = NULL;
+    n->sym = NULL;
+    n->paren = 0;
+}
+
+int isIntConst(Node *n, long long v){
+    return n->kind==N_NUM && intValue(n)==v;
+}
+
+int isRealConst(Node *n, double v){
+    return n->kind==N_REEL && realValue(n)==v;
+}
+
+// Litteraux des deux cotes: evalue comme le ferait le C (INT en int, FLOAT en double)
+int foldBinop(Node *n){
+    Node *a = n->a, *b = n->b;
+    if(!isLiteral(a) || !isLiteral(b)) return 0;
+
+    if(isComparison(n->op)){
+        int r;
+        if(a->vtype==TYPE_FLOAT){
+            double x = realValue(a), y = realValue(b);
+            r = n->op==TOK_EGAL ? x==y : n->op==TOK_DIFF ? x!=y :
+                n->op==TOK_INF ? x<y : n->op==TOK_SUP ? x>y :
+                n->op==TOK_INFEG ? x<=y : x>=y;
+        } else {
+            long long x = intValue(a), y = intValue(b);
+            r = n->op==TOK_EGAL ? x==y : n->op==TOK_DIFF ? x!=y :
+                n->op==TOK_INF ? x<y : n->op==TOK_SUP ? x>y :
+                n->op==TOK_INFEG ? x<=y : x>=y;
+        }
+        setIntLiteral(n,r);
+        return 1;
+    }
+
+    if(a->vtype==TYPE_INT){
+        long long x = intValue(a), y = intValue(b), r;
+        if(x>2147483647LL || y>2147483647LL) return 0;
+        switch(n->op){
+            case TOK_PLUS: r = x+y; break;
+            case TOK_MOINS: r = x-y; break;
+            case TOK_MUL: r = x*y; break;
+            case TOK_DIV:
+                if(y==0) return 0;
+                r = x/y;
+                break;
+            default: return 0;
+        }
+        // Le debordement reste a l'execution, INT_MIN n'a pas d'ecriture litterale
+        if(r>2147483647LL || r<-2147483647LL) return 0;
+        setIntLiteral(n,r);
+        return 1;
+    }
+
+    if(a->vtype==TYPE_FLOAT){
+        double x = realValue(a), y = realValue(b), r;
+        switch(n->op){
+            case TOK_PLUS: r = x+y; break;
+            case TOK_MOINS: r = x-y; break;
+            case TOK_MUL: r = x*y; break;
+            case TOK_DIV: r = x/y; break;
+            default: return 0;
+        }
+        if(r!=r || r-r!=0) return 0;   // NaN ou infini: laisse tel quel
+        setRealLiteral(n,r);
+        return 1;
+    }
+    return 0;
+}
+
+// Elements neutres et absorbants; en FLOAT seul *1.0 et /1.0 sont exacts
+int simplifyBinop(Node *n){
+    Node *a = n->a, *b = n->b;
+
+    if(n->vtype==TYPE_INT){
+        switch(n->op){
+            case TOK_PLUS:
+                if(isIntConst(b,0)){ replaceNode(n,a); return 1; }
+                if(isIntConst(a,0)){ replaceNode(n,b); return 1; }
+                break;
+            case TOK_MOINS:
+                if(isIntConst(b,0)){ replaceNode(n,a); return 1; }
+                break;
+            case TOK_MUL:
+                if(isIntConst(b,1)){ replaceNode(n,a); return 1; }
+                if(isIntConst(a,1)){ replaceNode(n,b); return 1; }
+                if((isIntConst(b,0) && isPure(a) && !canTrap(a)) || (isIntConst(a,0) && isPure(b) && !canTrap(b))){
+                    setIntLiteral(n,0);
+                    return 1;
+                }
+                break;
+            case TOK_DIV:
+                if(isIntConst(b,1)){ replaceNode(n,a); return 1; }
+                break;
+            default:
+                break;
+        }
+    }
+    else if(n->vtype==TYPE_FLOAT){
+        if((n->op==TOK_MUL || n->op==TOK_DIV) && isRealConst(b,1.0)){ replaceNode(n,a); return 1; }
+        if(n->op==TOK_MUL && isRealConst(a,1.0)){ replaceNode(n,b); return 1; }
+    }
+    return 0;
+}
+
+void foldExpr(Node *n){
+    switch(n->kind){
+        case N_INDEX:
+            foldExpr(n->a);
+            break;
+        case N_APPEL:
+            for(Node *arg=n->a;arg;arg=arg->next)
+                foldExpr(arg);
+            break;
+        case N_BINOP:
+            foldExpr(n->a);
+            foldExpr(n->b);
+            if(foldBinop(n)) cc->nbFolded++;
+            else if(simplifyBinop(n)) cc->nbSimplified++;
+            break;
+        default:
+            break;
+    }
+}
+
+void foldBloc(Node *list){
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_AFFECT:
+                foldExpr(n->a);
+                foldExpr(n->b);
+                break;
+            case N_RETOURNER:
+            case N_ECRIRE:
+            case N_LIRE:
+                foldExpr(n->a);
+                break;
+            case N_POUR:
+                foldExpr(n->b);
+                foldExpr(n->c);
+                foldBloc(n->d);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                foldExpr(n->a);
+                foldBloc(n->d);
+                break;
+            case N_SI:
+                foldExpr(n->a);
+                foldBloc(n->b);
+                foldBloc(n->c);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Elimination de code mort: branches SI/TANTQUE constantes, instructions
+   apres RETOURNER et variables locales jamais lues. */
+
+int literalTrue(Node *n){
+    return n->kind==N_REEL ? realValue(n)!=0 : intValue(n)!=0;
+}
+
+int blocReturns(Node *list);
+
+// L'instruction se termine toujours par un RETOURNER
+int alwaysReturns(Node *n){
+    if(n->kind==N_RETOURNER) return 1;
+    if(n->kind==N_SI) return n->c && blocReturns(n->b) && blocReturns(n->c);
+    return 0;
+}
+
+int blocReturns(Node *list){
+    for(Node *n=list;n;n=n->next)
+        if(alwaysReturns(n)) return 1;
+    return 0;
+}
+
+Node *dceBloc(Node *list){
+    Node *head = NULL, **tail = &head;
+    for(Node *n=list, *next; n; n=next){
+        next = n->next;
+        n->next = NULL;
+
+        switch(n->kind){
+            case N_SI:
+                n->b = dceBloc(n->b);
+                n->c = dceBloc(n->c);
+                if(isLiteral(n->a)){
+                    Node *kept = literalTrue(n->a) ? n->b : n->c;
+                    if(kept) kept->elseIf = 0;
+                    *tail = kept;
+                    while(*tail) tail = &(*tail)->next;
+                    cc->nbDeadBranches++;
+                    // La branche gardee se termine par RETOURNER: la suite est morte
+                    if(blocReturns(kept)){
+                        for(Node *r=next;r;r=r->next) cc->nbUnreachable++;
+                        return head;
+                    }
+                    n = NULL;
+                }
+                break;
+            case N_TANTQUE:
+                n->d = dceBloc(n->d);
+                if(isLiteral(n->a) && !literalTrue(n->a)){
+                    cc->nbDeadBranches++;
+                    n = NULL;
+                }
+                break;
+            case N_POUR:
+                n->d = dceBloc(n->d);
+                // Bornes constantes vides: seule reste l'initialisation de la variable
+                if(n->b->kind==N_NUM && n->c->kind==N_NUM && intValue(n->b)>intValue(n->c)){
+                    Node *init = newNode(N_AFFECT,n->tok);
+                    init->a = n->a;
+                    init->b = n->b;
+                    n = init;
+                    cc->nbDeadBranches++;
+                }
+                break;
+            case N_REPETER:
+                n->d = dceBloc(n->d);
+                break;
+            default:
+                break;
+        }
+        if(!n) continue;
+
+        *tail = n;
+        tail = &n->next;
+        if(alwaysReturns(n)){
+            for(Node *r=next;r;r=r->next) cc->nbUnreachable++;
+            break;
+        }
+    }
+    return head;
+}
+
+void countExpr(Node *e){
+    switch(e->kind){
+        case N_VAR:
+            e->sym->reads++;
+            break;
+        case N_INDEX:
+            e->sym->reads++;
+            countExpr(e->a);
+            break;
+        case N_APPEL:
+            for(Node *arg=e->a;arg;arg=arg->next)
+                countExpr(arg);
+            break;
+        case N_BINOP:
+            countExpr(e->a);
+            countExpr(e->b);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Une cible ecrite par LIRE, POUR ou une affectation a effet de bord doit rester
+   declaree; de meme si l'affectation peut echouer, sinon -O1 ferait disparaitre
+   l'erreur que -O0 signale. */
+void countBloc(Node *list){
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_AFFECT:
+                if(n->a->kind==N_INDEX) countExpr(n->a->a);
+                countExpr(n->b);
+                if(!isPure(n->b) || !isPure(n->a->a) || canTrap(n->b) || canTrap(n->a))
+                    n->a->sym->pinned = 1;
+                break;
+            case N_LIRE:
+                if(n->a->kind==N_INDEX) countExpr(n->a->a);
+                n->a->sym->pinned = 1;
+                break;
+            case N_RETOURNER:
+                countExpr(n->a);
+                break;
+            case N_ECRIRE:
+                if(n->a->kind!=N_STRING) countExpr(n->a);
+                break;
+            case N_POUR:
+                n->a->sym->pinned = 1;
+                countExpr(n->b);
+                countExpr(n->c);
+                countBloc(n->d);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                countExpr(n->a);
+                countBloc(n->d);
+                break;
+            case N_SI:
+                countExpr(n->a);
+                countBloc(n->b);
+                countBloc(n->c);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Retire les affectations vers des variables supprimees
+Node *removeDeadStores(Node *list){
+    Node *head = NULL, **tail = &head;
+    for(Node *n=list, *next; n; n=next){
+        next = n->next;
+        n->next = NULL;
+        if(n->kind==N_AFFECT && n->a->sym->dead) continue;
+        if(n->kind==N_SI){
+            n->b = removeDeadStores(n->b);
+            n->c = removeDeadStores(n->c);
+        }
+        else if(n->kind==N_POUR || n->kind==N_TANTQUE || n->kind==N_REPETER)
+            n->d = removeDeadStores(n->d);
+        *tail = n;
+        tail = &n->next;
+    }
+    return head;
+}
+
+// Supprime les locales jamais lues jusqu'a stabilite (une suppression peut en liberer d'autres)
+void dceLocals(Node **decls, Node *params, Node **body){
+    for(;;){
+        for(Node *d=params;d;d=d->next) d->sym->reads = d->sym->pinned = 0;
+        for(Node *d=*decls;d;d=d->next) d->sym->reads = d->sym->pinned = 0;
+        countBloc(*body);
+
+        int removed = 0;
+        for(Node **p=decls;*p;){
+            Symbol *sym = (*p)->sym;
+            if(sym->reads==0 && !sym->pinned){
+                sym->dead = 1;
+                *p = (*p)->next;
+                cc->nbUnusedVars++;
+                removed = 1;
+            }
+            else p = &(*p)->next;
+        }
+        if(!removed) break;
+        *body = removeDeadStores(*body);
+    }
+}
+
+/* Boucles: les expressions invariantes (ni appel, ni variable ecrite dans
+   la boucle) sont calculees une fois avant elle dans une temporaire _invN,
+   et un indice t[i*c+k] d'une POUR sur i devient une variable _idxN avancee
+   de c a chaque tour. Seules les expressions INT sont concernees: une
+   temporaire C de meme type donne exactement la meme valeur. */
+
+#define MAX_LOOP_TEMPS 32
+
+typedef struct {
+    int stamp;          // marque des symboles ecrits dans la boucle
+    Node **decls;       // declarations de la fonction, les temporaires y sont ajoutees
+    Node **link;        // insertion avant la boucle
+    Node *exprs[MAX_LOOP_TEMPS];   // expressions deja sorties (partagees si identiques)
+    Symbol *temps[MAX_LOOP_TEMPS];
+    int count;
+} LoopCtx;
+
+void markWrites(Node *list, int stamp){
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_AFFECT:
+            case N_LIRE:
+                n->a->sym->loopMark = stamp;
+                break;
+            case N_POUR:
+                n->a->sym->loopMark = stamp;
+                markWrites(n->d,stamp);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                markWrites(n->d,stamp);
+                break;
+            case N_SI:
+                markWrites(n->b,stamp);
+                markWrites(n->c,stamp);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* allowTrap: l'expression est de toute facon evaluee avant la boucle (borne,
+   condition de TANTQUE); sinon ni division ni acces tableau, qui pourraient
+   echouer alors que le corps ne s'execute pas. */
+int isInvariant(Node *e, int stamp, int allowTrap){
+    switch(e->kind){
+        case N_NUM:
+            return 1;
+        case N_VAR:
+            return e->sym->loopMark!=stamp && e->sym->arraySize==0 && e->vtype==TYPE_INT;
+        case N_INDEX:
+            return allowTrap && e->sym->loopMark!=stamp && e->vtype==TYPE_INT &&
+                isInvariant(e->a,stamp,allowTrap);
+        case N_BINOP:
+            return e->vtype==TYPE_INT && (allowTrap || e->op!=TOK_DIV) &&
+                isInvariant(e->a,stamp,allowTrap) && isInvariant(e->b,stamp,allowTrap);
+        default:
+            return 0;
+    }
+}
+
+int exprEqual(Node *x, Node *y){
+    if(!x || !y) return x==y;
+    if(x->kind!=y->kind || x->op!=y->op || x->sym!=y->sym) return 0;
+    if(x->kind==N_NUM) return intValue(x)==intValue(y);
+    return exprEqual(x->a,y->a) && exprEqual(x->b,y->b);
+}
+
+Node *varNode(Symbol *sym, Token at){
+    Node *n = newNode(N_VAR,at);
+    n->tok.text = sym->name;
+    n->sym = sym;
+    n->vtype = sym->vtype;
+    return n;
+}
+
+// Nouvelle locale scalaire, declaree en fin de liste
+Symbol *newTemp(Node **decls, const char *name, VarType vtype, Token at){
+    Symbol *sym = arenaAlloc(&cc->arena,sizeof(Symbol));
+    memset(sym,0,sizeof(Symbol));
+    sym->name = intern(name,strlen(name));
+    sym->kind = SYM_VAR;
+    sym->vtype = vtype;
+    sym->scope = 1;
+
+    Node *d = newNode(N_DECL,at);
+    d->tok.text = sym->name;
+    d->vtype = vtype;
+    d->sym = sym;
+    while(*decls) decls = &(*decls)->next;
+    *decls = d;
+    return sym;
+}
+
+// Nouvelle locale INT _<prefixe>N
+Symbol *newLoopTemp(Node **decls, const char *prefix, Token at){
+    char buf[32];
+    snprintf(buf,sizeof(buf),"_%s%d",prefix,++cc->loopTemps);
+    return newTemp(decls,buf,TYPE_INT,at);
+}
+
+Node *newAffect(Symbol *target, Node *value, Token at){
+    Node *n = newNode(N_AFFECT,at);
+    n->a = varNode(target,at);
+    n->b = value;
+    return n;
+}
+
+// Copie du noeud seul: ses fils sont partages
+Node *copyNode(Node *e){
+    Node *copy = arenaAlloc(&cc->arena,sizeof(Node));
+    *copy = *e;
+    copy->next = NULL;
+    copy->paren = 0;
+    return copy;
+}
+
+void insertBefore(LoopCtx *lc, Node *n){
+    n->next = *lc->link;
+    *lc->link = n;
+    lc->link = &n->next;
+}
+
+void hoist(Node *e, LoopCtx *lc){
+    Symbol *temp = NULL;
+    for(int k=0;k<lc->count && !temp;k++)
+        if(exprEqual(lc->exprs[k],e)) temp = lc->temps[k];
+    if(!temp){
+        if(lc->count==MAX_LOOP_TEMPS) return;
+        Node *moved = copyNode(e);
+        temp = newLoopTemp(lc->decls,"inv",e->tok);
+        insertBefore(lc,newAffect(temp,moved,e->tok));
+        lc->exprs[lc->count] = moved;
+        lc->temps[lc->count++] = temp;
+        cc->nbHoisted++;
+    }
+    replaceNode(e,varNode(temp,e->tok));
+}
+
+// Sort les plus grandes sous-expressions invariantes (une variable seule n'y gagne rien)
+void hoistExpr(Node *e, LoopCtx *lc, int allowTrap){
+    if((e->kind==N_BINOP || e->kind==N_INDEX) && isInvariant(e,lc->stamp,allowTrap)){
+        hoist(e,lc);
+        return;
+    }
+    switch(e->kind){
+        case N_INDEX:
+            hoistExpr(e->a,lc,allowTrap);
+            break;
+        case N_APPEL:
+            for(Node *arg=e->a;arg;arg=arg->next)
+                hoistExpr(arg,lc,allowTrap);
+            break;
+        case N_BINOP:
+            hoistExpr(e->a,lc,allowTrap);
+            hoistExpr(e->b,lc,allowTrap);
+            break;
+        default:
+            break;
+    }
+}
+
+void hoistBloc(Node *list, LoopCtx *lc){
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_AFFECT:
+            case N_LIRE:
+                if(n->a->kind==N_INDEX) hoistExpr(n->a->a,lc,0);
+                if(n->kind==N_AFFECT) hoistExpr(n->b,lc,0);
+                break;
+            case N_ECRIRE:
+                if(n->a->kind!=N_STRING) hoistExpr(n->a,lc,0);
+                break;
+            case N_POUR:
+                hoistExpr(n->b,lc,0);
+                hoistExpr(n->c,lc,0);
+                hoistBloc(n->d,lc);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                hoistExpr(n->a,lc,0);
+                hoistBloc(n->d,lc);
+                break;
+            case N_SI:
+                hoistExpr(n->a,lc,0);
+                hoistBloc(n->b,lc);
+                hoistBloc(n->c,lc);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Coefficient c de i*c ou c*i (litteral ou variable invariante), NULL sinon
+Node *mulCoef(Node *m, Symbol *iv, int stamp){
+    if(m->kind!=N_BINOP || m->op!=TOK_MUL) return NULL;
+    Node *c = NULL;
+    if(m->a->kind==N_VAR && m->a->sym==iv) c = m->b;
+    else if(m->b->kind==N_VAR && m->b->sym==iv) c = m->a;
+    if(c && (c->kind==N_NUM || (c->kind==N_VAR && isInvariant(c,stamp,0)))) return c;
+    return NULL;
+}
+
+// i*c, i*c+k, k+i*c ou i*c-k avec k invariant
+Node *linearCoef(Node *e, Symbol *iv, int stamp){
+    Node *c = mulCoef(e,iv,stamp);
+    if(c || e->kind!=N_BINOP) return c;
+    if(e->op==TOK_PLUS || e->op==TOK_MOINS){
+        if((c = mulCoef(e->a,iv,stamp)) && isInvariant(e->b,stamp,0)) return c;
+        if(e->op==TOK_PLUS && (c = mulCoef(e->b,iv,stamp)) && isInvariant(e->a,stamp,0)) return c;
+    }
+    return NULL;
+}
+
+// Copie de e ou la variable iv est remplacee par 'by'
+Node *substExpr(Node *e, Symbol *iv, Node *by){
+    if(e->kind==N_VAR && e->sym==iv){
+        Node *n = copyNode(by);
+        n->paren = by->paren;
+        return n;
+    }
+    Node *n = copyNode(e);
+    if(e->kind==N_BINOP){
+        n->a = substExpr(e->a,iv,by);
+        n->b = substExpr(e->b,iv,by);
+    }
+    return n;
+}
+
+typedef struct {
+    LoopCtx *lc;
+    Node *loop;
+    Node *last;         // derniere instruction du corps (avancement ajoute apres)
+} ReduceCtx;
+
+void reduceExpr(Node *e, ReduceCtx *rc);
+
+void reduceIndex(Node *n, ReduceCtx *rc){
+    LoopCtx *lc = rc->lc;
+    Symbol *iv = rc->loop->a->sym;
+    Node *c = linearCoef(n->a,iv,lc->stamp);
+    if(!c){
+        reduceExpr(n->a,rc);
+        return;
+    }
+
+    Symbol *temp = NULL;
+    for(int k=0;k<lc->count && !temp;k++)
+        if(exprEqual(lc->exprs[k],n->a)) temp = lc->temps[k];
+    if(!temp){
+        if(lc->count==MAX_LOOP_TEMPS) return;
+        Node *index = copyNode(n->a);
+        temp = newLoopTemp(lc->decls,"idx",n->tok);
+        // Avant la boucle: l'indice pour la premiere valeur de i
+        Node *first = substExpr(index,iv,rc->loop->b);
+        // Plis d'une expression creee ici: pas comptes avec ceux de la source
+        long folded = cc->nbFolded, simplified = cc->nbSimplified;
+        foldExpr(first);
+        cc->nbFolded = folded;
+        cc->nbSimplified = simplified;
+        insertBefore(lc,newAffect(temp,first,n->tok));
+        // En fin de corps: _idxN = _idxN + c
+        Node *step = newNode(N_BINOP,n->tok);
+        step->op = TOK_PLUS;
+        step->vtype = TYPE_INT;
+        step->a = varNode(temp,n->tok);
+        step->b = copyNode(c);
+        rc->last->next = newAffect(temp,step,n->tok);
+        rc->last = rc->last->next;
+        lc->exprs[lc->count] = index;
+        lc->temps[lc->count++] = temp;
+        cc->nbReduced++;
+    }
+    replaceNode(n->a,varNode(temp,n->tok));
+}
+
+void reduceExpr(Node *e, ReduceCtx *rc){
+    switch(e->kind){
+        case N_INDEX:
+            reduceIndex(e,rc);
+            break;
+        case N_APPEL:
+            for(Node *arg=e->a;arg;arg=arg->next)
+                reduceExpr(arg,rc);
+            break;
+        case N_BINOP:
+            reduceExpr(e->a,rc);
+            reduceExpr(e->b,rc);
+            break;
+        default:
+            break;
+    }
+}
+
+void reduceBloc(Node *list, ReduceCtx *rc){
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_AFFECT:
+            case N_LIRE:
+                if(n->a->kind==N_INDEX) reduceIndex(n->a,rc);
+                if(n->kind==N_AFFECT) reduceExpr(n->b,rc);
+                break;
+            case N_RETOURNER:
+                reduceExpr(n->a,rc);
+                break;
+            case N_ECRIRE:
+                if(n->a->kind!=N_STRING) reduceExpr(n->a,rc);
+                break;
+            case N_POUR:
+                reduceExpr(n->b,rc);
+                reduceExpr(n->c,rc);
+                reduceBloc(n->d,rc);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                reduceExpr(n->a,rc);
+                reduceBloc(n->d,rc);
+                break;
+            case N_SI:
+                reduceExpr(n->a,rc);
+                reduceBloc(n->b,rc);
+                reduceBloc(n->c,rc);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int hasLoops(Node *list){
+    for(Node *n=list;n;n=n->next){
+        if(n->kind==N_POUR || n->kind==N_TANTQUE || n->kind==N_REPETER) return 1;
+        if(n->kind==N_SI && (hasLoops(n->b) || hasLoops(n->c))) return 1;
+    }
+    return 0;
+}
+
+/* i, i+k, k+i, i-k, ou les formes de linearCoef avec un coefficient
+   litteral non nul: deux tours n'ecrivent jamais le meme element */
+int isAffine(Node *e, Symbol *iv, int stamp){
+    if(e->kind==N_VAR && e->sym==iv) return 1;
+    Node *c = linearCoef(e,iv,stamp);
+    if(c) return c->kind==N_NUM && intValue(c)!=0;
+    if(e->kind!=N_BINOP || (e->op!=TOK_PLUS && e->op!=TOK_MOINS)) return 0;
+    if(e->a->kind==N_VAR && e->a->sym==iv) return isInvariant(e->b,stamp,0);
+    return e->op==TOK_PLUS && e->b->kind==N_VAR && e->b->sym==iv && isInvariant(e->a,stamp,0);
+}
+
+// Premier indice auquel le corps ecrit le tableau, NULL s'il n'y est pas ecrit
+Node *arrayWriteIndex(Node *list, Symbol *array){
+    Node *found = NULL;
+    for(Node *n=list;n && !found;n=n->next){
+        switch(n->kind){
+            case N_AFFECT:
+            case N_LIRE:
+                if(n->a->kind==N_INDEX && n->a->sym==array) found = n->a->a;
+                break;
+            case N_POUR:
+            case N_TANTQUE:
+            case N_REPETER:
+                found = arrayWriteIndex(n->d,array);
+                break;
+            case N_SI:
+                if(!(found = arrayWriteIndex(n->b,array))) found = arrayWriteIndex(n->c,array);
+                break;
+            default:
+                break;
+        }
+    }
+    return found;
+}
+
+// Lectures: un tableau ecrit ne l'est qu'au meme indice, un scalaire ecrit jamais
+const char *simdReads(Node *e, Node *loop, int stamp){
+    const char *why = NULL;
+    switch(e->kind){
+        case N_VAR:
+            if(e->sym->loopMark==stamp && e->sym!=loop->a->sym)
+                return "scalaire ecrit et relu dans la boucle";
+            break;
+        case N_INDEX:
+            if(e->sym->loopMark==stamp && !exprEqual(arrayWriteIndex(loop->d,e->sym),e->a))
+                return "dependance entre iterations";
+            return simdReads(e->a,loop,stamp);
+        case N_BINOP:
+            if((why = simdReads(e->a,loop,stamp))) return why;
+            return simdReads(e->b,loop,stamp);
+        default:
+            break;
+    }
+    return NULL;
+}
+
+/* POUR la plus interne dont les tours sont independants: seulement des
+   affectations, chaque tableau ecrit a un seul indice affine en i et n'est
+   relu qu'a cet indice, le seul scalaire ecrit est une reduction INT
+   s ~ s + e ou s ~ s * e. Renvoie NULL, ou la raison du refus. */
+const char *simdCheck(Node *loop){
+    Symbol *iv = loop->a->sym;
+    int stamp = ++cc->loopStamp;
+    markWrites(loop->d,stamp);
+    if(iv->loopMark==stamp) return "variable de boucle modifiee";
+    iv->loopMark = stamp;
+    if(!isPure(loop->b) || !isPure(loop->c)) return "appel dans les bornes";
+    if(loop->c->kind==N_NUM && intValue(loop->c)>=2147483647LL) return "borne maximale";
+
+    loop->sym = NULL;
+    for(Node *n=loop->d;n;n=n->next){
+        if(n->kind!=N_AFFECT) return "instruction autre qu'une affectation";
+        if(!isPure(n->b)) return "appel de fonction";
+        Node *target = n->a, *value = n->b;
+        const char *why;
+        if(target->kind==N_INDEX){
+            if(!isAffine(target->a,iv,stamp)) return "indice d'ecriture non affine";
+            if(!exprEqual(arrayWriteIndex(loop->d,target->sym),target->a))
+                return "tableau ecrit a plusieurs indices";
+            if((why = simdReads(target->a,loop,stamp))) return why;
+        } else {
+            if(target->sym->vtype!=TYPE_INT) return "reduction FLOAT ou CHAR";
+            if(value->kind!=N_BINOP || (value->op!=TOK_PLUS && value->op!=TOK_MUL))
+                return "scalaire ecrit dans la boucle";
+            if(value->a->kind==N_VAR && value->a->sym==target->sym) value = value->b;
+            else if(value->b->kind==N_VAR && value->b->sym==target->sym) value = value->a;
+            else return "scalaire ecrit dans la boucle";
+            if(loop->sym && (loop->sym!=target->sym || loop->op!=n->b->op))
+                return "plusieurs reductions";
+            loop->sym = target->sym;
+            loop->op = n->b->op;
+        }
+        if((why = simdReads(value,loop,stamp))) return why;
+    }
+    return NULL;
+}
+
+// Marque la boucle pour la generation et le signale avec --opt-report
+int simdLoop(Node *loop){
+    if(!simdMode || loop->kind!=N_POUR || !loop->d || hasLoops(loop->d)) return 0;
+    const char *why = simdCheck(loop);
+    cc->nbSimdCandidates++;
+    if(why){
+        loop->sym = NULL;
+        if(optReport) fprintf(cc->diag,"simd: ligne %d: POUR non vectorisee (%s)\n",loop->tok.line,why);
+        return 0;
+    }
+    loop->simd = 1;
+    cc->nbSimd++;
+    if(optReport){
+        fprintf(cc->diag,"simd: ligne %d: POUR vectorisee",loop->tok.line);
+        if(loop->sym) fprintf(cc->diag," (reduction %s:%s)",loop->op==TOK_PLUS ? "+" : "*",loop->sym->name);
+        fputc('\n',cc->diag);
+    }
+    return 1;
+}
+
+/* *link designe la boucle; les temporaires sont inserees devant elle.
+   Renvoie le nouvel emplacement de la boucle dans la liste. */
+Node **optimiseLoop(Node **link, Node **decls){
+    Node *loop = *link;
+    LoopCtx lc;
+    lc.stamp = ++cc->loopStamp;
+    lc.decls = decls;
+    lc.link = link;
+    lc.count = 0;
+
+    if(loop->kind==N_POUR) loop->a->sym->loopMark = lc.stamp;
+    markWrites(loop->d,lc.stamp);
+
+    // La borne de fin et la condition de TANTQUE sont evaluees au moins une fois
+    if(loop->kind==N_POUR) hoistExpr(loop->c,&lc,isPure(loop->b));
+    else hoistExpr(loop->a,&lc,loop->kind==N_TANTQUE);
+    hoistBloc(loop->d,&lc);
+    simdLoop(loop);
+    return lc.link;
+}
+
+/* --parallel: une POUR dont les tours sont independants est repartie entre
+   les coeurs. Le corps n'a ni ECRIRE, LIRE, RETOURNER ni appel; un tableau
+   ecrit l'est a un seul indice affine en i et n'est relu qu'a cet indice;
+   un scalaire ecrit est soit prive (ecrit sans condition, au premier niveau
+   du corps, avant toute lecture: lastprivate lui rend sa valeur du dernier
+   tour), soit une reduction INT s ~ s + e ou s ~ s * e. La premiere POUR
+   acceptee en partant de l'exterieur l'emporte: pas de regions imbriquees. */
+
+#define MAX_PAR_VARS 32
+
+typedef struct {
+    Node *loop;
+    int stamp;          // marque des symboles ecrits dans le corps
+    Symbol *privates[MAX_PAR_VARS];
+    int nprivates;
+    Symbol *reductions[MAX_PAR_VARS];
+    unsigned char ops[MAX_PAR_VARS];
+    int nreductions;
+} ParCtx;
+
+int symIndex(Symbol **list, int n, Symbol *sym){
+    for(int k=0;k<n;k++)
+        if(list[k]==sym) return k;
+    return -1;
+}
+
+const char *parReads(Node *e, ParCtx *pc){
+    const char *why;
+    switch(e->kind){
+        case N_VAR:
+            if(e->sym->loopMark==pc->stamp && e->sym!=pc->loop->a->sym &&
+               symIndex(pc->privates,pc->nprivates,e->sym)<0)
+                return "scalaire lu d'un tour a l'autre";
+            break;
+        case N_INDEX:
+            if(e->sym->loopMark==pc->stamp && !exprEqual(arrayWriteIndex(pc->loop->d,e->sym),e->a))
+                return "dependance entre iterations";
+            return parReads(e->a,pc);
+        case N_APPEL:
+            return "appel de fonction";
+        case N_BINOP:
+            if((why = parReads(e->a,pc))) return why;
+            return parReads(e->b,pc);
+        default:
+            break;
+    }
+    return NULL;
+}
+
+const char *parAffect(Node *n, ParCtx *pc, int top){
+    Node *target = n->a, *value = n->b, *rest = NULL;
+    const char *why;
+    if(target->kind==N_INDEX){
+        if(!isAffine(target->a,pc->loop->a->sym,pc->stamp)) return "indice d'ecriture non affine";
+        if(!exprEqual(arrayWriteIndex(pc->loop->d,target->sym),target->a))
+            return "tableau ecrit a plusieurs indices";
+        if((why = parReads(target->a,pc))) return why;
+        return parReads(value,pc);
+    }
+
+    Symbol *sym = target->sym;
+    if(symIndex(pc->privates,pc->nprivates,sym)>=0) return parReads(value,pc);
+
+    if(sym->vtype==TYPE_INT && value->kind==N_BINOP && (value->op==TOK_PLUS || value->op==TOK_MUL)){
+        if(value->a->kind==N_VAR && value->a->sym==sym) rest = value->b;
+        else if(value->b->kind==N_VAR && value->b->sym==sym) rest = value->a;
+    }
+    int k = symIndex(pc->reductions,pc->nreductions,sym);
+    if(rest){
+        if(k<0){
+            if(pc->nreductions==MAX_PAR_VARS) return "trop de variables";
+            k = pc->nreductions++;
+            pc->reductions[k] = sym;
+            pc->ops[k] = value->op;
+        }
+        else if(pc->ops[k]!=value->op) return "reduction a deux operateurs";
+        return parReads(rest,pc);
+    }
+    if(k>=0) return "variable de reduction reecrite";
+    if(!top) return "scalaire ecrit sous condition";
+    if((why = parReads(value,pc))) return why;
+    if(pc->nprivates==MAX_PAR_VARS) return "trop de variables";
+    pc->privates[pc->nprivates++] = sym;
+    return NULL;
+}
+
+const char *parBloc(Node *list, ParCtx *pc, int top){
+    const char *why = NULL;
+    for(Node *n=list;n && !why;n=n->next){
+        switch(n->kind){
+            case N_ECRIRE:
+            case N_LIRE:
+                return "ECRIRE ou LIRE";
+            case N_RETOURNER:
+                return "RETOURNER";
+            case N_AFFECT:
+                why = parAffect(n,pc,top);
+                break;
+            case N_POUR: {
+                Symbol *var = n->a->sym;
+                if((why = parReads(n->b,pc)) || (why = parReads(n->c,pc))) break;
+                if(symIndex(pc->privates,pc->nprivates,var)<0){
+                    if(!top) return "scalaire ecrit sous condition";
+                    if(pc->nprivates==MAX_PAR_VARS) return "trop de variables";
+                    pc->privates[pc->nprivates++] = var;
+                }
+                why = parBloc(n->d,pc,0);
+                break;
+            }
+            case N_TANTQUE:
+            case N_REPETER:
+                if(!(why = parReads(n->a,pc))) why = parBloc(n->d,pc,0);
+                break;
+            case N_SI:
+                if(!(why = parReads(n->a,pc)) && !(why = parBloc(n->b,pc,0)))
+                    why = parBloc(n->c,pc,0);
+                break;
+            default:
+                break;
+        }
+    }
+    return why;
+}
+
+// Renvoie NULL si la POUR peut etre repartie (variables privees et reductions dans pc)
+const char *parallelCheck(Node *loop, ParCtx *pc){
+    Symbol *iv = loop->a->sym;
+    pc->loop = loop;
+    pc->stamp = ++cc->loopStamp;
+    pc->nprivates = pc->nreductions = 0;
+    markWrites(loop->d,pc->stamp);
+    if(iv->loopMark==pc->stamp) return "variable de boucle modifiee";
+    iv->loopMark = pc->stamp;
+    // OpenMP calcule le nombre de tours une fois pour toutes
+    if(!isInvariant(loop->c,pc->stamp,1)) return "borne de fin modifiee dans la boucle";
+    return parBloc(loop->d,pc,1);
+}
+
+void parallelBloc(Node *list){
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_POUR: {
+                ParCtx pc;
+                const char *why = parallelCheck(n,&pc);
+                cc->nbParallelCandidates++;
+                if(optReport){
+                    if(why) fprintf(cc->diag,"parallele: ligne %d: POUR non parallelisee (%s)\n",n->tok.line,why);
+                    else fprintf(cc->diag,"parallele: ligne %d: POUR parallelisee\n",n->tok.line);
+                }
+                if(!why){
+                    n->parallel = 1;
+                    cc->nbParallel++;
+                }
+                else parallelBloc(n->d);
+                break;
+            }
+            case N_TANTQUE:
+            case N_REPETER:
+                parallelBloc(n->d);
+                break;
+            case N_SI:
+                parallelBloc(n->b);
+                parallelBloc(n->c);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Reduction de force dans la POUR *link: i ne doit changer que par la
+   boucle elle-meme, et le corps ne doit pas toujours sortir par RETOURNER */
+Node **reduceLoop(Node **link, Node **decls){
+    Node *loop = *link;
+    Symbol *iv = loop->a->sym;
+    LoopCtx lc;
+    lc.stamp = ++cc->loopStamp;
+    lc.decls = decls;
+    lc.link = link;
+    lc.count = 0;
+
+    if(!loop->d || !isPure(loop->b) || blocReturns(loop->d)) return link;
+    markWrites(loop->d,lc.stamp);
+    if(iv->loopMark==lc.stamp) return link;
+    iv->loopMark = lc.stamp;
+
+    ReduceCtx rc = { &lc, loop, loop->d };
+    while(rc.last->next) rc.last = rc.last->next;
+    reduceBloc(loop->d,&rc);
+    return lc.link;
+}
+
+/* Une boucle vectorisee ou parallele garde ses indices affines: un _idxN
+   avance a chaque tour lierait les iterations entre elles */
+void reduceLoops(Node **list, Node **decls){
+    for(Node **link=list;*link;link=&(*link)->next){
+        Node *n = *link;
+        switch(n->kind){
+            case N_POUR:
+                if(n->parallel) break;
+                if(!n->simd) link = reduceLoop(link,decls);
+                reduceLoops(&(*link)->d,decls);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                reduceLoops(&n->d,decls);
+                break;
+            case N_SI:
+                reduceLoops(&n->b,decls);
+                reduceLoops(&n->c,decls);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void loopsBloc(Node **list, Node **decls){
+    for(Node **link=list;*link;link=&(*link)->next){
+        Node *n = *link;
+        switch(n->kind){
+            case N_POUR:
+            case N_TANTQUE:
+            case N_REPETER:
+                link = optimiseLoop(link,decls);
+                loopsBloc(&(*link)->d,decls);
+                break;
+            case N_SI:
+                loopsBloc(&n->b,decls);
+                loopsBloc(&n->c,decls);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Inlining: une FONCTION sans locale dont le corps est un seul RETOURNER
+   d'une expression INT d'au plus inlineThreshold noeuds, qui ne s'appelle
+   pas elle-meme, est recopiee a ses sites d'appel. Une variable remplace
+   directement son parametre, de meme qu'un litteral INT ou CHAR, ou un
+   argument INT sans appel utilise une seule fois par un corps sans appel
+   (un FLOAT doit etre arrondi comme le parametre). Les autres sont ranges avant l'instruction dans une temporaire _inl<N>_<parametre>: il
+   faut une instruction evaluee une fois (ni condition de boucle, ni borne
+   de POUR) et un argument sans appel, qui ne peut echouer (division,
+   tableau) que si aucun appel ne le precede dans l'instruction. Le corps
+   recopie est lui-meme reparcouru avant la substitution des arguments (h(3)
+   -> sq(3)+1 -> 3*3+1), sans temporaire, sur MAX_INLINE_DEPTH niveaux au
+   plus: une recursion indirecte s'arrete la. */
+
+int inlineThreshold = 12;   // --inline-seuil: taille maximale en noeuds, 0 desactive
+
+#define MAX_INLINE_DEPTH 4
+
+int exprSize(Node *e){
+    int size = 1;
+    if(e->kind==N_APPEL){
+        for(Node *arg=e->a;arg;arg=arg->next)
+            size += exprSize(arg);
+    }
+    else if(e->kind==N_INDEX) size += exprSize(e->a);
+    else if(e->kind==N_BINOP) size += exprSize(e->a)+exprSize(e->b);
+    return size;
+}
+
+int callsFunction(Node *e, Symbol *f){
+    if(e->kind==N_APPEL){
+        if(e->sym==f) return 1;
+        for(Node *arg=e->a;arg;arg=arg->next)
+            if(callsFunction(arg,f)) return 1;
+        return 0;
+    }
+    if(e->kind==N_INDEX) return callsFunction(e->a,f);
+    if(e->kind==N_BINOP) return callsFunction(e->a,f) || callsFunction(e->b,f);
+    return 0;
+}
+
+int countUses(Node *e, Symbol *param){
+    if(e->kind==N_VAR) return e->sym==param;
+    if(e->kind==N_INDEX) return countUses(e->a,param);
+    if(e->kind==N_BINOP) return countUses(e->a,param)+countUses(e->b,param);
+    if(e->kind==N_APPEL){
+        int uses = 0;
+        for(Node *arg=e->a;arg;arg=arg->next)
+            uses += countUses(arg,param);
+        return uses;
+    }
+    return 0;
+}
+
+/* Copie complete de e; les parametres params[k] y sont remplaces par des
+   copies de by[k] (by = NULL: copie simple) */
+Node *inlineCopy(Node *e, Symbol **params, Node **by, int n){
+    if(e->kind==N_VAR && by){
+        for(int k=0;k<n;k++)
+            if(e->sym==params[k]){
+                Node *arg = inlineCopy(by[k],NULL,NULL,0);
+                arg->paren = by[k]->paren;
+                return arg;
+            }
+    }
+    Node *copy = copyNode(e);
+    copy->paren = e->paren;
+    if(e->kind==N_APPEL){
+        Node **tail = &copy->a;
+        for(Node *arg=e->a;arg;arg=arg->next){
+            *tail = inlineCopy(arg,params,by,n);
+            tail = &(*tail)->next;
+        }
+    }
+    else if(e->kind==N_INDEX) copy->a = inlineCopy(e->a,params,by,n);
+    else if(e->kind==N_BINOP){
+        copy->a = inlineCopy(e->a,params,by,n);
+        copy->b = inlineCopy(e->b,params,by,n);
+    }
+    return copy;
+}
+
+/* Apres l'analyse de f: garde une copie de son expression si elle peut etre
+   recopiee. La copie ne bouge plus: les corps compiles en parallele la
+   lisent sans la modifier. */
+void prepareInline(Node *f){
+    Node *r = f->c;
+    if(optLevel==0 || inlineThreshold==0 || cc->errorCount || f->b) return;
+    if(!r || r->next || r->kind!=N_RETOURNER || r->a->vtype!=TYPE_INT) return;
+    if(exprSize(r->a)>inlineThreshold || callsFunction(r->a,f->sym)) return;
+
+    Symbol **params = arenaAlloc(&cc->arena,(f->sym->paramCount+1)*sizeof(Symbol*));
+    int k = 0;
+    for(Node *p=f->a;p;p=p->next)
+        params[k++] = p->sym;
+    f->sym->inlineParams = params;
+    f->sym->inlineExpr = inlineCopy(r->a,NULL,NULL,0);
+}
+
+// Forme du corps seule, avant l'analyse (pre-passe de la compilation parallele)
+int mayInline(Node *f){
+    return optLevel>0 && inlineThreshold>0 && !f->b && f->c && !f->c->next &&
+           f->c->kind==N_RETOURNER && exprSize(f->c->a)<=inlineThreshold;
+}
+
+typedef struct {
+    Node **decls;       // locales de l'appelant, les temporaires y sont ajoutees
+    Node **link;        // insertion avant l'instruction en cours
+    int once;           // instruction evaluee une fois: temporaires permises
+    int called;         // un appel est deja evalue dans l'instruction
+    int depth;          // corps recopie en cours de reparcours (0: l'instruction)
+    long inlined;       // sites remplaces, cascades comprises
+} InlineCtx;
+
+void inlineExpr(Node *e, InlineCtx *ic);
+
+// Raison du refus, ou NULL si le site est remplace par le corps
+const char *inlineCall(Node *e, InlineCtx *ic){
+    Symbol *f = e->sym;
+    int n = f->paramCount, k = 0;
+
+    // Les parametres de f n'existent pas chez l'appelant: pas de temporaire dans le corps
+    Node *body = inlineCopy(f->inlineExpr,NULL,NULL,0);
+    InlineCtx nested = { ic->decls, NULL, 0, 0, ic->depth+1, 0 };
+    if(nested.depth<MAX_INLINE_DEPTH) inlineExpr(body,&nested);
+    int leafBody = isPure(body);
+    Node **by = arenaAlloc(&cc->arena,(n+1)*sizeof(Node*));
+    unsigned char *temp = arenaAlloc(&cc->arena,n+1);
+
+    for(Node *arg=e->a;arg;arg=arg->next,k++){
+        Symbol *param = f->inlineParams[k];
+        by[k] = arg;
+        temp[k] = 0;
+        if(arg->kind==N_VAR || arg->kind==N_NUM || arg->kind==N_CHAR_LIT) continue;
+        if(!isPure(arg)) return "argument avec appel";
+        if(param->vtype==TYPE_INT && leafBody && countUses(body,param)==1) continue;
+        if(!ic->once) return "argument a evaluer a chaque tour";
+        if(ic->called && canTrap(arg)) return "argument pouvant echouer apres un appel";
+        temp[k] = 1;
+    }
+
+    int site = 0;
+    for(k=0;k<n;k++){
+        if(!temp[k]) continue;
+        if(!site) site = ++cc->inlineTemps;
+        Symbol *param = f->inlineParams[k];
+        char name[96];
+        snprintf(name,sizeof(name),"_inl%d_%s",site,param->name);
+        Symbol *t = newTemp(ic->decls,name,param->vtype,e->tok);
+        Node *set = newAffect(t,by[k],e->tok);
+        set->next = *ic->link;
+        *ic->link = set;
+        ic->link = &set->next;
+        by[k] = varNode(t,e->tok);
+    }
+    replaceNode(e,inlineCopy(body,f->inlineParams,by,n));
+    ic->inlined += nested.inlined+1;
+    return NULL;
+}
+
+// Sites d'appel dans l'ordre d'evaluation, arguments d'abord
+void inlineExpr(Node *e, InlineCtx *ic){
+    switch(e->kind){
+        case N_INDEX:
+            inlineExpr(e->a,ic);
+            break;
+        case N_APPEL: {
+            for(Node *arg=e->a;arg;arg=arg->next)
+                inlineExpr(arg,ic);
+            if(!e->sym->inlineExpr){
+                ic->called = 1;
+                break;
+            }
+            const char *name = e->sym->name;
+            int line = e->tok.line;
+            const char *why = inlineCall(e,ic);
+            if(optReport && !ic->depth){
+                if(why) fprintf(cc->diag,"inlining: ligne %d: appel de %s conserve (%s)\n",line,name,why);
+                else fprintf(cc->diag,"inlining: ligne %d: appel de %s remplace par son corps\n",line,name);
+            }
+            if(why || !isPure(e)) ic->called = 1;
+            break;
+        }
+        case N_BINOP:
+            inlineExpr(e->a,ic);
+            inlineExpr(e->b,ic);
+            break;
+        default:
+            break;
+    }
+}
+
+void inlineBloc(Node **list, Node **decls){
+    for(Node **link=list;*link;link=&(*link)->next){
+        Node *n = *link;
+        InlineCtx ic = { decls, link, 1, 0, 0, 0 };
+        switch(n->kind){
+            case N_AFFECT:
+            case N_LIRE:
+                if(n->a->kind==N_INDEX) inlineExpr(n->a->a,&ic);
+                if(n->kind==N_AFFECT) inlineExpr(n->b,&ic);
+                break;
+            case N_RETOURNER:
+                inlineExpr(n->a,&ic);
+                break;
+            case N_ECRIRE:
+                if(n->a->kind!=N_STRING) inlineExpr(n->a,&ic);
+                break;
+            case N_POUR:
+                inlineExpr(n->b,&ic);
+                ic.once = 0;
+                inlineExpr(n->c,&ic);
+                inlineBloc(&n->d,decls);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                ic.once = 0;
+                inlineExpr(n->a,&ic);
+                inlineBloc(&n->d,decls);
+                break;
+            case N_SI:
+                inlineExpr(n->a,&ic);
+                inlineBloc(&n->b,decls);
+                inlineBloc(&n->c,decls);
+                break;
+            default:
+                break;
+        }
+        cc->nbInlined += ic.inlined;
+        // Des temporaires precedent l'instruction: un SINON SI devient un bloc SINON
+        if(ic.link!=link){
+            n->elseIf = 0;
+            link = ic.link;
+        }
+    }
+}
+
+void inlineCalls(Node **body, Node **decls){
+    cc->inlineTemps = 0;
+    inlineBloc(body,decls);
+}
+
+// Invariants et vectorisation, puis repartition entre coeurs, puis reduction de force
+void optimiseLoops(Node **body, Node **decls){
+    cc->loopTemps = 0;
+    loopsBloc(body,decls);
+    if(parallelMode) parallelBloc(*body);
+    reduceLoops(body,decls);
+}
+
+void optimiseFonction(Node *f){
+    if(optLevel==0) return;
+    inlineCalls(&f->c,&f->b);
+    foldBloc(f->c);
+    f->c = dceBloc(f->c);
+    optimiseLoops(&f->c,&f->b);
+    dceLocals(&f->b,f->a,&f->c);
+}
+
+void optimiseMain(Node *prog){
+    if(optLevel==0) return;
+    inlineCalls(&prog->c,&prog->b);
+    foldBloc(prog->c);
+    prog->c = dceBloc(prog->c);
+    optimiseLoops(&prog->c,&prog->b);
+    dceLocals(&prog->b,NULL,&prog->c);
+}
+
+void reportOptimisations(){
+    if(optLevel==0 || !optReport) return;
+    fprintf(cc->diag,"optimisation: %ld operations constantes pliees, %ld simplifications\n",
+        cc->nbFolded, cc->nbSimplified);
+    fprintf(cc->diag,"code mort: %ld branches constantes, %ld instructions inaccessibles, %ld variables inutilisees\n",
+        cc->nbDeadBranches, cc->nbUnreachable, cc->nbUnusedVars);
+    fprintf(cc->diag,"inlining: %ld appels remplaces par le corps de la fonction\n",cc->nbInlined);
+    fprintf(cc->diag,"boucles: %ld expressions invariantes sorties, %ld indices reduits\n",
+        cc->nbHoisted, cc->nbReduced);
+    if(simdMode)
+        fprintf(cc->diag,"simd: %ld boucles POUR vectorisees sur %ld candidates\n",
+            cc->nbSimd, cc->nbSimdCandidates);
+    if(parallelMode)
+        fprintf(cc->diag,"parallele: %ld boucles POUR parallelisees sur %ld candidates\n",
+            cc->nbParallel, cc->nbParallelCandidates);
+}
+
+void optimiseProgramme(Node *prog){
+    for(Node *f=prog->a;f;f=f->next)
+        optimiseFonction(f);
+    optimiseMain(prog);
+    reportOptimisations();
+}
+
+/* ---------- Generation de code C ---------- */
+
+int opPrec(TokenType op){
+    switch(op){
+        case TOK_MUL: case TOK_DIV: return 3;
+        case TOK_PLUS: case TOK_MOINS: return 2;
+        default: return 1;
+    }
+}
+
+const char *opText(TokenType op){
+    switch(op){
+        case TOK_PLUS: return "+";
+        case TOK_MOINS: return "-";
+        case TOK_MUL: return "*";
+        case TOK_DIV: return "/";
+        case TOK_EGAL: return "==";
+        case TOK_DIFF: return "!=";
+        case TOK_INF: return "<";
+        case TOK_SUP: return ">";
+        case TOK_INFEG: return "<=";
+        case TOK_SUPEG: return ">=";
+        default: return "==";
+    }
+}
+
+const char *readFunction(VarType t){
+    return (t==TYPE_INT)?"algo_read_int":(t==TYPE_FLOAT)?"algo_read_float":"algo_read_char";
+}
+
+// prec: priorite minimale exigee par le contexte; parentheses si l'expression est moins liee
+void genExpr(Node *n, int prec){
+    int p = n->kind==N_BINOP ? opPrec(n->op) : 4;
+    int par = n->paren || p < prec;
+    if(par) outChar('(');
+
+    switch(n->kind){
+        case N_NUM:
+        case N_REEL:
+            outStr(n->tok.text);
+            break;
+        case N_CHAR_LIT:
+            outChar('\'');
+            outStr(n->tok.text);
+            outChar('\'');
+            break;
+        case N_VAR:
+            outStr(n->sym->name);
+            break;
+        case N_INDEX:
+            outStr(n->sym->name);
+            outChar('[');
+            genExpr(n->a,0);
+            outChar(']');
+            break;
+        case N_APPEL:
+            outStr(n->sym->name);
+            outChar('(');
+            for(Node *arg=n->a;arg;arg=arg->next){
+                if(arg!=n->a) outStr(", ");
+                genExpr(arg,0);
+            }
+            outChar(')');
+            break;
+        case N_BINOP:
+            genExpr(n->a,p);
+            outChar(' ');
+            outStr(opText(n->op));
+            outChar(' ');
+            genExpr(n->b,p+1);
+            break;
+        default:
+            break;
+    }
+
+    if(par) outChar(')');
+}
+
+void genBloc(Node *list);
+
+/* POUR i DE a A b ... FINPOUR dont le corps est le seul LIRE(t[i]): la fin b
+   est relue a chaque tour, elle doit donc etre une constante ou une variable
+   que la boucle ne modifie pas */
+int isTableRead(Node *n){
+    Node *body = n->d, *end = n->c;
+    if(n->parallel || n->simd || !body || body->next || body->kind!=N_LIRE) return 0;
+    Node *target = body->a;
+    if(target->kind!=N_INDEX || target->a->kind!=N_VAR || target->a->sym!=n->a->sym) return 0;
+    return end->kind==N_NUM || (end->kind==N_VAR && end->sym!=n->a->sym);
+}
+
+// Lecture du tableau d'un seul appel; i finit a b + 1 comme apres la boucle
+void genTableRead(Node *n){
+    const char *var = n->a->sym->name;
+    printIndent();
+    outStr("algo_flush();\n");
+    printIndent();
+    outStr(var);
+    outStr(" = ");
+    genExpr(n->b,0);
+    outStr(";\n");
+    printIndent();
+    outStr("if(");
+    outStr(var);
+    outStr(" <= ");
+    genExpr(n->c,0);
+    outStr("){\n");
+    cc->indent++;
+    printIndent();
+    outStr(readFunction(n->d->a->vtype));
+    outStr("s(&");
+    outStr(n->d->a->sym->name);
+    outChar('[');
+    outStr(var);
+    outStr("], (long)");
+    genExpr(n->c,4);
+    outStr(" - ");
+    outStr(var);
+    outStr(" + 1);\n");
+    printIndent();
+    outStr(var);
+    outStr(" = ");
+    genExpr(n->c,opPrec(TOK_PLUS));
+    outStr(" + 1;\n");
+    cc->indent--;
+    printIndent();
+    outStr("}\n");
+}
+
+// Variables privees et reductions recalculees sur le corps definitif
+void genParallelPragma(Node *n){
+    ParCtx pc;
+    parallelCheck(n,&pc);
+    printIndent();
+    outStr(n->simd ? "#pragma omp parallel for simd lastprivate(" : "#pragma omp parallel for lastprivate(");
+    outStr(n->a->sym->name);
+    for(int k=0;k<pc.nprivates;k++){
+        outStr(", ");
+        outStr(pc.privates[k]->name);
+    }
+    outChar(')');
+    for(int k=0;k<pc.nreductions;k++){
+        outStr(" reduction(");
+        outStr(opText(pc.ops[k]));
+        outChar(':');
+        outStr(pc.reductions[k]->name);
+        outChar(')');
+    }
+    outChar('\n');
+}
+
+void genInstr(Node *n){
+    switch(n->kind){
+        case N_AFFECT:
+            printIndent();
+            genExpr(n->a,0);
+            outStr(" = ");
+            genExpr(n->b,0);
+            outStr(";\n");
+            break;
+
+        case N_RETOURNER:
+            printIndent();
+            outStr("return ");
+            genExpr(n->a,0);
+            outStr(";\n");
+            break;
+
+        case N_ECRIRE:
+            printIndent();
+            if(n->a->kind==N_STRING){
+                outStr("algo_puts(\"");
+                outStr(n->a->tok.text);
+                outStr("\\n\");\n");
+            } else {
+                outStr(n->a->vtype==TYPE_FLOAT ? "algo_print_double(" :
+                       n->a->vtype==TYPE_CHAR ? "algo_print_char(" : "algo_print_int(");
+                genExpr(n->a,0);
+                outStr(");\n");
+            }
+            break;
+
+        case N_LIRE:
+            printIndent();
+            outStr("algo_flush();\n");
+            printIndent();
+            outStr(readFunction(n->a->vtype));
+            outStr("(&");
+            genExpr(n->a,0);
+            outStr(");\n");
+            break;
+
+        case N_TANTQUE:
+            printIndent();
+            outStr("while(");
+            genExpr(n->a,0);
+            outStr("){\n");
+            genBloc(n->d);
+            printIndent();
+            outStr("}\n");
+            break;
+
+        case N_REPETER:
+            printIndent();
+            outStr("do{\n");
+            genBloc(n->d);
+            printIndent();
+            outStr("} while(");
+            genExpr(n->a,0);
+            outStr(");\n");
+            break;
+
+        case N_POUR: {
+            const char *var = n->a->sym->name;
+            if(isTableRead(n)){
+                genTableRead(n);
+                break;
+            }
+            // Forme canonique pour le vectoriseur: i < fin + 1
+            if(n->parallel) genParallelPragma(n);
+            else if(n->simd){
+                printIndent();
+                outStr("#pragma omp simd");
+                if(n->sym){
+                    outStr(" reduction(");
+                    outStr(opText(n->op));
+                    outChar(':');
+                    outStr(n->sym->name);
+                    outChar(')');
+                }
+                outChar('\n');
+            }
+            printIndent();
+            outStr("for(");
+            outStr(var);
+            outStr(" = ");
+            genExpr(n->b,0);
+            outStr("; ");
+            outStr(var);
+            if(!n->simd){
+                outStr(" <= ");
+                genExpr(n->c,0);
+            } else if(n->c->kind==N_NUM){
+                outStr(" < ");
+                outInt(intValue(n->c)+1);
+            } else {
+                outStr(" < ");
+                genExpr(n->c,opPrec(TOK_PLUS));
+                outStr(" + 1");
+            }
+            outStr("; ");
+            outStr(var);
+            outStr("++){\n");
+            genBloc(n->d);
+            printIndent();
+            outStr("}\n");
+            break;
+        }
+
+        case N_SI:
+            if(!n->elseIf) printIndent();
+            outStr("if(");
+            genExpr(n->a,0);
+            outStr("){\n");
+            genBloc(n->b);
+            printIndent();
+            if(n->c && n->c->kind==N_SI && n->c->elseIf){
+                outStr("} else ");
+                genInstr(n->c);
+            } else if(n->c){
+                outStr("} else {\n");
+                genBloc(n->c);
+                printIndent();
+                outStr("}\n");
+            } else {
+                outStr("}\n");
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void genBloc(Node *list){
+    cc->indent++;
+    for(Node *n=list;n;n=n->next)
+        genInstr(n);
+    cc->indent--;
+}
+
+void genDecls(Node *list){
+    for(Node *d=list;d;d=d->next){
+        printIndent();
+        outStr(typeToCStr(d->vtype));
+        outChar(' ');
+        outStr(d->sym->name);
+        if(d->arraySize>0){
+            outChar('[');
+            outInt(d->arraySize);
+            outChar(']');
+        }
+        outStr(";\n");
+    }
+}
+
+void genFonction(Node *f){
+    outStr("int ");
+    outStr(f->sym->name);
+    outChar('(');
+    for(Node *p=f->a;p;p=p->next){
+        if(p!=f->a) outStr(", ");
+        outStr(typeToCStr(p->vtype));
+        outChar(' ');
+        outStr(p->sym->name);
+    }
+    outStr("){\n");
+
+    cc->indent++;
+    genDecls(f->b);
+    cc->indent--;
+    genBloc(f->c);
+
+    outStr("}\n\n");
+}
+
+/* Sortie des programmes generes: ECRIRE remplit un tampon, vide dans stdout
+   avant chaque LIRE et a la fin de main, sans interpretation de format.
+   Un FLOAT de moins de 10^12 est ecrit comme printf("%f"): v*10^6 est
+   calcule exactement (mantisse * 5^6 sur 128 bits, decalee) puis arrondi
+   au pair; au-dela, ou sans entiers de 128 bits, printf prend le relais. */
+static const char runtimeSortie[] =
+    "static char algo_out[1 << 16];\n"
+    "static int algo_outLen;\n"
+    "\n"
+    "static void algo_flush(void){\n"
+    "    if(algo_outLen) fwrite(algo_out, 1, algo_outLen, stdout);\n"
+    "    algo_outLen = 0;\n"
+    "}\n"
+    "\n"
+    "static inline void algo_putc(char c){\n"
+    "    if(algo_outLen == (int)sizeof(algo_out)) algo_flush();\n"
+    "    algo_out[algo_outLen++] = c;\n"
+    "}\n"
+    "\n"
+    "static inline void algo_puts(const char *s){\n"
+    "    while(*s) algo_putc(*s++);\n"
+    "}\n"
+    "\n"
+    "static inline void algo_digits(unsigned long long v){\n"
+    "    char buf[20];\n"
+    "    int n = 0;\n"
+    "    do{ buf[n++] = '0' + v % 10; v /= 10; }while(v);\n"
+    "    while(n) algo_putc(buf[--n]);\n"
+    "}\n"
+    "\n"
+    "static inline void algo_print_int(int v){\n"
+    "    unsigned u = v;\n"
+    "    if(v < 0){ algo_putc('-'); u = 0u - u; }\n"
+    "    algo_digits(u);\n"
+    "    algo_putc('\\n');\n"
+    "}\n"
+    "\n"
+    "static inline void algo_print_char(char c){\n"
+    "    algo_putc(c);\n"
+    "    algo_putc('\\n');\n"
+    "}\n"
+    "\n"
+    "static inline void algo_print_double(double v){\n"
+    "#ifdef __SIZEOF_INT128__\n"
+    "    if(v < 1e12 && v > -1e12){\n"
+    "        union { double d; unsigned long long u; } x = { v };\n"
+    "        int e = (int)(x.u >> 52 & 0x7ff);\n"
+    "        unsigned long long m = x.u & ((1ULL << 52) - 1), q = 0;\n"
+    "        if(e) m |= 1ULL << 52; else e = 1;\n"
+    "        int k = 1069 - e;   /* v*10^6 = m*15625 / 2^k */\n"
+    "        if(k < 128){\n"
+    "            unsigned __int128 n = (unsigned __int128)m * 15625;\n"
+    "            q = (unsigned long long)(n >> k);\n"
+    "            unsigned __int128 r = n - ((unsigned __int128)q << k), half = (unsigned __int128)1 << (k - 1);\n"
+    "            if(r > half || (r == half && (q & 1))) q++;\n"
+    "        }\n"
+    "        if(x.u >> 63) algo_putc('-');\n"
+    "        algo_digits(q / 1000000);\n"
+    "        algo_putc('.');\n"
+    "        unsigned f = (unsigned)(q % 1000000);\n"
+    "        for(unsigned p = 100000; p; p /= 10) algo_putc('0' + f / p % 10);\n"
+    "        algo_putc('\\n');\n"
+    "        return;\n"
+    "    }\n"
+    "#endif\n"
+    "    algo_flush();\n"
+    "    printf(\"%f\\n\", v);\n"
+    "}\n"
+    "\n";
+
+/* Entree des programmes generes: stdin est lu par blocs de 64 Ko (setvbuf)
+   et decoupe par lignes dans algo_in, termine par un zero qui sert de
+   sentinelle; une ligne a la fois garde les programmes interactifs.
+   Les lectures suivent scanf (" %d", " %f", " %c"): blancs sautes, variable
+   inchangee en cas d'echec. Un FLOAT d'au plus 7 chiffres significatifs et
+   d'exposant decimal dans [-10,10] est calcule exactement en une operation
+   float; sinon sscanf arrondit le texte lu. */
+static const char runtimeEntree[] =
+    "static char algo_in[1 << 16];\n"
+    "static char *algo_inPos = algo_in;\n"
+    "\n"
+    "static int algo_fill(void){\n"
+    "    static int started;\n"
+    "    if(!started){ setvbuf(stdin, NULL, _IOFBF, 1 << 16); started = 1; }\n"
+    "    algo_inPos = algo_in;\n"
+    "    if(fgets(algo_in, sizeof(algo_in), stdin)) return 1;\n"
+    "    algo_in[0] = 0;\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "static inline int algo_peek(void){\n"
+    "    if(!*algo_inPos && !algo_fill()) return -1;\n"
+    "    return (unsigned char)*algo_inPos;\n"
+    "}\n"
+    "\n"
+    "static inline int algo_skip(void){\n"
+    "    int c;\n"
+    "    while((c = algo_peek()) == ' ' || (c >= '\\t' && c <= '\\r')) algo_inPos++;\n"
+    "    return c;\n"
+    "}\n"
+    "\n"
+    "static inline int algo_read_int(int *x){\n"
+    "    int c = algo_skip(), neg = 0;\n"
+    "    unsigned v = 0;\n"
+    "    if(c == '-' || c == '+'){ neg = c == '-'; algo_inPos++; c = algo_peek(); }\n"
+    "    if(c < '0' || c > '9') return 0;\n"
+    "    do{ v = v * 10 + (c - '0'); algo_inPos++; c = algo_peek(); }while(c >= '0' && c <= '9');\n"
+    "    *x = (int)(neg ? 0u - v : v);\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static inline int algo_read_char(char *x){\n"
+    "    int c = algo_skip();\n"
+    "    if(c < 0) return 0;\n"
+    "    *x = (char)c;\n"
+    "    algo_inPos++;\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static inline int algo_read_float(float *x){\n"
+    "    static const float p10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };\n"
+    "    char tok[512];\n"
+    "    int c = algo_skip(), n = 0, digits = 0, frac = 0, dot = 0, e = 0, eneg = 0;\n"
+    "    unsigned long long m = 0;\n"
+    "    if(c == '-' || c == '+'){ tok[n++] = (char)c; algo_inPos++; c = algo_peek(); }\n"
+    "    while((c >= '0' && c <= '9') || (c == '.' && !dot)){\n"
+    "        if(c == '.') dot = 1;\n"
+    "        else if(++digits <= 18){ m = m * 10 + (c - '0'); frac += dot; }\n"
+    "        if(n < 500) tok[n++] = (char)c;\n"
+    "        algo_inPos++;\n"
+    "        c = algo_peek();\n"
+    "    }\n"
+    "    if(!digits) return 0;\n"
+    "    if(c == 'e' || c == 'E'){\n"
+    "        tok[n++] = (char)c; algo_inPos++; c = algo_peek();\n"
+    "        if(c == '-' || c == '+'){ eneg = c == '-'; tok[n++] = (char)c; algo_inPos++; c = algo_peek(); }\n"
+    "        while(c >= '0' && c <= '9'){\n"
+    "            if(e < 10000) e = e * 10 + (c - '0');\n"
+    "            if(n < 508) tok[n++] = (char)c;\n"
+    "            algo_inPos++;\n"
+    "            c = algo_peek();\n"
+    "        }\n"
+    "    }\n"
+    "    tok[n] = 0;\n"
+    "    int p = (eneg ? -e : e) - frac;\n"
+    "    if(digits <= 18 && m <= 16777216 && p >= -10 && p <= 10){\n"
+    "        float f = p < 0 ? (float)m / p10[-p] : (float)m * p10[p];\n"
+    "        *x = tok[0] == '-' ? -f : f;\n"
+    "        return 1;\n"
+    "    }\n"
+    "    return sscanf(tok, \"%f\", x) == 1;\n"
+    "}\n"
+    "\n"
+    "/* POUR i DE a A b ... FINPOUR sur LIRE(t[i]): n lectures d'affilee, arret au premier echec */\n"
+    "static inline void algo_read_ints(int *t, long n){\n"
+    "    while(n-- > 0 && algo_read_int(t++));\n"
+    "}\n"
+    "\n"
+    "static inline void algo_read_floats(float *t, long n){\n"
+    "    while(n-- > 0 && algo_read_float(t++));\n"
+    "}\n"
+    "\n"
+    "static inline void algo_read_chars(char *t, long n){\n"
+    "    while(n-- > 0 && algo_read_char(t++));\n"
+    "}\n"
+    "\n";
+
+#define RT_SORTIE 1     // ECRIRE, et LIRE qui vide la sortie avant de lire
+#define RT_ENTREE 2     // LIRE
+
+// Runtimes dont ont besoin les instructions de la liste
+int runtimeNeeds(Node *list){
+    int needs = 0;
+    for(Node *n=list;n;n=n->next){
+        switch(n->kind){
+            case N_ECRIRE:
+                needs |= RT_SORTIE;
+                break;
+            case N_LIRE:
+                needs |= RT_SORTIE|RT_ENTREE;
+                break;
+            case N_POUR:
+            case N_TANTQUE:
+            case N_REPETER:
+                needs |= runtimeNeeds(n->d);
+                break;
+            case N_SI:
+                needs |= runtimeNeeds(n->b) | runtimeNeeds(n->c);
+                break;
+            default:
+                break;
+        }
+    }
+    return needs;
+}
+
+int programmeNeeds(Node *prog){
+    int needs = runtimeNeeds(prog->c);
+    for(Node *f=prog->a;f;f=f->next)
+        needs |= runtimeNeeds(f->c);
+    return needs;
+}
+
+// Ecrit les runtimes demandes; cc->runtimes garde ceux du programme
+void genRuntimes(int needs){
+    if(needs&RT_SORTIE) outStr(runtimeSortie);
+    if(needs&RT_ENTREE) outStr(runtimeEntree);
+    cc->runtimes |= needs;
+}
+
+void genEntete(int needs){
+    outStr("#include <stdio.h>\n\n");
+    genRuntimes(needs);
+}
+
+void genMain(Node *prog){
+    outStr("int main(){\n");
+    cc->indent++;
+    genDecls(prog->b);
+    cc->indent--;
+    genBloc(prog->c);
+    if(cc->runtimes&RT_SORTIE) outStr("    algo_flush();\n");
+    outStr("    return 0;\n}\n");
+}
+
+// Prototype sans noms de parametres: int f(int, float);
+void genPrototype(const char *name, int paramCount, VarType *types){
+    outStr("int ");
+    outStr(name);
+    outChar('(');
+    for(int k=0;k<paramCount;k++){
+        if(k) outStr(", ");
+        outStr(typeToCStr(types[k]));
+    }
+    outStr(");\n");
+}
+
+// Seulement si un appel vise une fonction definie plus loin
+void genPrototypes(Node *prog){
+    if(!cc->forwardCalls) return;
+    for(Node *f=prog->a;f;f=f->next)
+        genPrototype(f->sym->name,f->sym->paramCount,f->sym->paramTypes);
+    outChar('\n');
+}
+
+void genProgramme(Node *prog){
+    genEntete(programmeNeeds(prog));
+    genPrototypes(prog);
+    for(Node *f=prog->a;f;f=f->next)
+        genFonction(f);
+    genMain(prog);
+}
+
+/* ---------- Machine virtuelle (--run) ---------- */
+
+/* Bytecode a pile: chaque fonction a un cadre de 'nslots' cases (parametres,
+   puis variables, les tableaux occupant 'arraySize' cases contigues), suivi de
+   sa pile d'operandes. Les FLOAT sont calcules en double comme dans le C genere
+   (litteraux double) et arrondis en float quand les deux operandes sont float. */
+typedef enum {
+    OP_PUSH_I, OP_PUSH_D,
+    OP_LOAD, OP_STORE, OP_STORE_F, OP_STORE_C,
+    OP_LOADX, OP_STOREX, OP_STOREX_F, OP_STOREX_C,
+    OP_ADD_I, OP_SUB_I, OP_MUL_I, OP_DIV_I,
+    OP_ADD_D, OP_SUB_D, OP_MUL_D, OP_DIV_D,
+    OP_EQ_I, OP_NE_I, OP_LT_I, OP_GT_I, OP_LE_I, OP_GE_I,
+    OP_EQ_D, OP_NE_D, OP_LT_D, OP_GT_D, OP_LE_D, OP_GE_D,
+    OP_ROUND_F, OP_TO_C, OP_D2I,
+    OP_JMP, OP_JZ, OP_JNZ,
+    OP_CALL, OP_RET, OP_INC,
+    OP_PRINT_I, OP_PRINT_D, OP_PRINT_C, OP_PRINT_S,
+    OP_READ_I, OP_READ_F, OP_READ_C,
+    OP_READX_I, OP_READX_F, OP_READX_C,
+    OP_HALT
+} OpCode;
+
+typedef union { int i; double d; } Value;
+
+typedef struct {
+    int entry;      // adresse de la premiere instruction
+    int nparams;
+    int nslots;
+    int maxDepth;   // profondeur maximale de la pile d'operandes
+} BcFunc;
+
+struct Bytecode {
+    int *code;
+    int len, cap;
+    BcFunc *funcs;
+    int nfuncs;
+    double *reals;
+    int nreals, capReals;
+    const char **strs;
+    int nstrs, capStrs;
+    int depth, maxDepth;    // suivi de la pile pendant la compilation d'une fonction
+};
+
+typedef enum { CT_INT, CT_FLOAT, CT_DOUBLE } CType;
+
+void *growArray(void *p, int *cap, size_t elem){
+    *cap = *cap ? *cap*2 : 256;
+    p = realloc(p,(size_t)*cap*elem);
+    if(!p){
+        fatal("memoire insuffisante");
+    }
+    return p;
+}
+
+static void bcWord(int v){
+    if(cc->bc->len==cc->bc->cap) cc->bc->code = growArray(cc->bc->code,&cc->bc->cap,sizeof(int));
+    cc->bc->code[cc->bc->len++] = v;
+}
+
+// Emet une instruction et son effet sur la pile d'operandes
+static void bcOp(OpCode op, int effect){
+    bcWord(op);
+    cc->bc->depth += effect;
+    if(cc->bc->depth > cc->bc->maxDepth) cc->bc->maxDepth = cc->bc->depth;
+}
+
+static void bcOp1(OpCode op, int effect, int arg){
+    bcOp(op,effect);
+    bcWord(arg);
+}
+
+static void bcOp2(OpCode op, int effect, int arg1, int arg2){
+    bcOp(op,effect);
+    bcWord(arg1);
+    bcWord(arg2);
+}
+
+// Saut dont la cible sera fixee plus tard; renvoie l'emplacement de l'operande
+static int bcJump(OpCode op){
+    bcOp(op,op==OP_JMP ? 0 : -1);
+    bcWord(-1);
+    return cc->bc->len-1;
+}
+
+static void bcPatch(int at){
+    cc->bc->code[at] = cc->bc->len;
+}
+
+int bcReal(double v){
+    if(cc->bc->nreals==cc->bc->capReals) cc->bc->reals = growArray(cc->bc->reals,&cc->bc->capReals,sizeof(double));
+    cc->bc->reals[cc->bc->nreals] = v;
+    return cc->bc->nreals++;
+}
+
+// Texte d'ECRIRE avec les sequences d'echappement que le compilateur C aurait interpretees
+const char *ecrireText(const char *s){
+    size_t len = strlen(s);
+    char *d = arenaAlloc(&cc->arena,len+2), *p = d;
+    for(size_t i=0;i<len;i++){
+        if(s[i]=='\\' && i+1<len){
+            char e = s[++i];
+            *p++ = e=='n' ? '\n' : e=='t' ? '\t' : e=='r' ? '\r' : e=='0' ? '\0' : e;
+        }
+        else *p++ = s[i];
+    }
+    *p++ = '\n';
+    *p = 0;
+    return d;
+}
+
+int bcString(const char *s){
+    if(cc->bc->nstrs==cc->bc->capStrs) cc->bc->strs = growArray(cc->bc->strs,&cc->bc->capStrs,sizeof(char*));
+    cc->bc->strs[cc->bc->nstrs] = ecrireText(s);
+    return cc->bc->nstrs++;
+}
+
+CType bcExpr(Node *n);
+
+// Conversion implicite du C vers le type de la destination
+void bcConvert(VarType to){
+    if(to==TYPE_FLOAT) bcOp(OP_ROUND_F,0);
+    else if(to==TYPE_CHAR) bcOp(OP_TO_C,0);
+}
+
+CType bcExpr(Node *n){
+    switch(n->kind){
+        case N_NUM:
+            bcOp1(OP_PUSH_I,1,(int)intValue(n));
+            return CT_INT;
+        case N_CHAR_LIT:
+            bcOp1(OP_PUSH_I,1,(signed char)n->tok.text[0]);
+            return CT_INT;
+        case N_REEL:
+            bcOp1(OP_PUSH_D,1,bcReal(realValue(n)));
+            return CT_DOUBLE;
+        case N_VAR:
+            bcOp1(OP_LOAD,1,n->sym->slot);
+            return n->sym->vtype==TYPE_FLOAT ? CT_FLOAT : CT_INT;
+        case N_INDEX:
+            bcExpr(n->a);
+            bcOp2(OP_LOADX,0,n->sym->slot,n->sym->arraySize);
+            return n->sym->vtype==TYPE_FLOAT ? CT_FLOAT : CT_INT;
+        case N_APPEL: {
+            int i = 0;
+            for(Node *arg=n->a;arg;arg=arg->next){
+                bcExpr(arg);
+                bcConvert(n->sym->paramTypes[i++]);
+            }
+            bcOp1(OP_CALL,1-n->sym->paramCount,n->sym->slot);
+            return CT_INT;
+        }
+        case N_BINOP: {
+            CType t1 = bcExpr(n->a);
+            CType t2 = bcExpr(n->b);
+            int isReal = n->a->vtype==TYPE_FLOAT;
+            static const OpCode cmpI[] = {OP_EQ_I,OP_NE_I,OP_LT_I,OP_GT_I,OP_LE_I,OP_GE_I};
+            static const OpCode cmpD[] = {OP_EQ_D,OP_NE_D,OP_LT_D,OP_GT_D,OP_LE_D,OP_GE_D};
+            if(isComparison(n->op)){
+                int k = n->op-TOK_EGAL;
+                bcOp(isReal ? cmpD[k] : cmpI[k],-1);
+                return CT_INT;
+            }
+            int k = n->op-TOK_PLUS;
+            bcOp((isReal ? OP_ADD_D : OP_ADD_I)+k,-1);
+            if(!isReal) return CT_INT;
+            if(t1==CT_FLOAT && t2==CT_FLOAT){
+                bcOp(OP_ROUND_F,0);
+                return CT_FLOAT;
+            }
+            return CT_DOUBLE;
+        }
+        default:
+            return CT_INT;
+    }
+}
+
+// Condition de SI/TANTQUE/REPETER: un FLOAT est compare a 0
+void bcCond(Node *n){
+    bcExpr(n);
+    if(n->vtype==TYPE_FLOAT){
+        bcOp1(OP_PUSH_D,1,bcReal(0.0));
+        bcOp(OP_NE_D,-1);
+    }
+}
+
+OpCode storeOp(VarType t, int indexed){
+    if(t==TYPE_FLOAT) return indexed ? OP_STOREX_F : OP_STORE_F;
+    if(t==TYPE_CHAR) return indexed ? OP_STOREX_C : OP_STORE_C;
+    return indexed ? OP_STOREX : OP_STORE;
+}
+
+OpCode readOp(VarType t, int indexed){
+    if(t==TYPE_FLOAT) return indexed ? OP_READX_F : OP_READ_F;
+    if(t==TYPE_CHAR) return indexed ? OP_READX_C : OP_READ_C;
+    return indexed ? OP_READX_I : OP_READ_I;
+}
+
+void bcBloc(Node *list);
+
+void bcInstr(Node *n){
+    switch(n->kind){
+        case N_AFFECT: {
+            Symbol *sym = n->a->sym;
+            if(n->a->kind==N_INDEX){
+                bcExpr(n->a->a);
+                bcExpr(n->b);
+                bcOp2(storeOp(sym->vtype,1),-2,sym->slot,sym->arraySize);
+            } else {
+                bcExpr(n->b);
+                bcOp1(storeOp(sym->vtype,0),-1,sym->slot);
+            }
+            break;
+        }
+
+        case N_RETOURNER:
+            bcExpr(n->a);
+            if(n->a->vtype==TYPE_FLOAT) bcOp(OP_D2I,0);
+            bcOp(OP_RET,-1);
+            break;
+
+        case N_ECRIRE:
+            if(n->a->kind==N_STRING){
+                bcOp1(OP_PRINT_S,0,bcString(n->a->tok.text));
+            } else {
+                bcExpr(n->a);
+                bcOp(n->a->vtype==TYPE_FLOAT ? OP_PRINT_D :
+                     n->a->vtype==TYPE_CHAR ? OP_PRINT_C : OP_PRINT_I,-1);
+            }
+            break;
+
+        case N_LIRE: {
+            Symbol *sym = n->a->sym;
+            if(n->a->kind==N_INDEX){
+                bcExpr(n->a->a);
+                bcOp2(readOp(sym->vtype,1),-1,sym->slot,sym->arraySize);
+            }
+            else bcOp1(readOp(sym->vtype,0),0,sym->slot);
+            break;
+        }
+
+        case N_TANTQUE: {
+            int debut = cc->bc->len;
+            bcCond(n->a);
+            int fin = bcJump(OP_JZ);
+            bcBloc(n->d);
+            bcOp1(OP_JMP,0,debut);
+            bcPatch(fin);
+            break;
+        }
+
+        case N_REPETER: {
+            int debut = cc->bc->len;
+            bcBloc(n->d);
+            bcCond(n->a);
+            bcOp1(OP_JNZ,-1,debut);
+            break;
+        }
+
+        case N_POUR: {
+            int slot = n->a->sym->slot;
+            bcExpr(n->b);
+            bcOp1(OP_STORE,-1,slot);
+            int debut = cc->bc->len;
+            bcOp1(OP_LOAD,1,slot);
+            bcExpr(n->c);
+            bcOp(OP_LE_I,-1);
+            int fin = bcJump(OP_JZ);
+            bcBloc(n->d);
+            bcOp1(OP_INC,0,slot);
+            bcOp1(OP_JMP,0,debut);
+            bcPatch(fin);
+            break;
+        }
+
+        case N_SI: {
+            bcCond(n->a);
+            int sinon = bcJump(OP_JZ);
+            bcBloc(n->b);
+            if(n->c){
+                int fin = bcJump(OP_JMP);
+                bcPatch(sinon);
+                bcBloc(n->c);
+                bcPatch(fin);
+            }
+            else bcPatch(sinon);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void bcBloc(Node *list){
+    for(Node *n=list;n;n=n->next)
+        bcInstr(n);
+}
+
+// Attribue les cases du cadre; renvoie la premiere case libre
+int bcSlots(Node *decls, int slot){
+    for(Node *d=decls;d;d=d->next){
+        d->sym->slot = slot;
+        slot += d->arraySize>0 ? d->arraySize : 1;
+    }
+    return slot;
+}
+
+void bcFunction(BcFunc *f, Node *params, Node *decls, Node *body, int isMain){
+    f->entry = cc->bc->len;
+    f->nparams = 0;
+    for(Node *p=params;p;p=p->next) f->nparams++;
+    f->nslots = bcSlots(decls,bcSlots(params,0));
+    cc->bc->depth = cc->bc->maxDepth = 0;
+
+    bcBloc(body);
+    if(isMain) bcOp(OP_HALT,0);
+    else {
+        // Fin de fonction sans RETOURNER: renvoie 0
+        bcOp1(OP_PUSH_I,1,0);
+        bcOp(OP_RET,-1);
+    }
+    f->maxDepth = cc->bc->maxDepth;
+}
+
+// Le dernier BcFunc est main
+void bcProgramme(Node *prog){
+    int n = 0;
+    for(Node *f=prog->a;f;f=f->next) f->sym->slot = n++;
+    cc->bc = calloc(1,sizeof(Bytecode));
+    if(!cc->bc) fatal("memoire insuffisante");
+    cc->bc->nfuncs = n+1;
+    cc->bc->funcs = calloc(cc->bc->nfuncs,sizeof(BcFunc));
+    if(!cc->bc->funcs) fatal("memoire insuffisante");
+
+    for(Node *f=prog->a;f;f=f->next)
+        bcFunction(&cc->bc->funcs[f->sym->slot],f->a,f->b,f->c,0);
+    bcFunction(&cc->bc->funcs[n],NULL,prog->b,prog->c,1);
+}
+
+void vmError(const char *msg){
+    fflush(stdout);
+    fprintf(stderr,"ERREUR EXECUTION: %s\n",msg);
+    exit(1);
+}
+
+#define VM_STACK (1<<22)
+
+typedef struct { int pc; Value *fp; } VmFrame;
+
+int vmRun(){
+    Value *stack = calloc(VM_STACK,sizeof(Value));
+    Value *stackEnd = stack+VM_STACK;
+    int frameCap = 1024, depth = 0;
+    VmFrame *frames = malloc(frameCap*sizeof(VmFrame));
+    if(!stack || !frames) vmError("memoire insuffisante");
+
+    const int *code = cc->bc->code;
+    BcFunc *mainFn = &cc->bc->funcs[cc->bc->nfuncs-1];
+    Value *fp = stack, *sp = stack+mainFn->nslots;
+    int pc = mainFn->entry;
+    if(sp+mainFn->maxDepth > stackEnd) vmError("pile d'execution saturee");
+
+    static void *labels[] = {
+        &&L_PUSH_I, &&L_PUSH_D,
+        &&L_LOAD, &&L_STORE, &&L_STORE_F, &&L_STORE_C,
+        &&L_LOADX, &&L_STOREX, &&L_STOREX_F, &&L_STOREX_C,
+        &&L_ADD_I, &&L_SUB_I, &&L_MUL_I, &&L_DIV_I,
+        &&L_ADD_D, &&L_SUB_D, &&L_MUL_D, &&L_DIV_D,
+        &&L_EQ_I, &&L_NE_I, &&L_LT_I, &&L_GT_I, &&L_LE_I, &&L_GE_I,
+        &&L_EQ_D, &&L_NE_D, &&L_LT_D, &&L_GT_D, &&L_LE_D, &&L_GE_D,
+        &&L_ROUND_F, &&L_TO_C, &&L_D2I,
+        &&L_JMP, &&L_JZ, &&L_JNZ,
+        &&L_CALL, &&L_RET, &&L_INC,
+        &&L_PRINT_I, &&L_PRINT_D, &&L_PRINT_C, &&L_PRINT_S,
+        &&L_READ_I, &&L_READ_F, &&L_READ_C,
+        &&L_READX_I, &&L_READX_F, &&L_READX_C,
+        &&L_HALT
+    };
+
+#define NEXT goto *labels[code[pc++]]
+#define INDEX(base,size) ({ int ix_ = (--sp)->i; \
+        if((unsigned)ix_ >= (unsigned)(size)) vmError("indice de tableau hors limites"); \
+        &fp[(base)+ix_]; })
+#define BIN_I(expr) { int b = (--sp)->i; int a = sp[-1].i; sp[-1].i = (expr); NEXT; }
+#define BIN_D(expr) { double b = (--sp)->d; double a = sp[-1].d; sp[-1].d = (expr); NEXT; }
+#define CMP_D(expr) { double b = (--sp)->d; double a = sp[-1].d; sp[-1].i = (expr); NEXT; }
+
+    NEXT;
+
+L_PUSH_I: (sp++)->i = code[pc++]; NEXT;
+L_PUSH_D: (sp++)->d = cc->bc->reals[code[pc++]]; NEXT;
+L_LOAD: *sp++ = fp[code[pc++]]; NEXT;
+L_STORE: fp[code[pc++]] = *--sp; NEXT;
+L_STORE_F: --sp; fp[code[pc++]].d = (float)sp->d; NEXT;
+L_STORE_C: --sp; fp[code[pc++]].i = (char)sp->i; NEXT;
+L_LOADX: { int base = code[pc++], size = code[pc++]; Value v = *INDEX(base,size); *sp++ = v; NEXT; }
+L_STOREX: { int base = code[pc++], size = code[pc++]; Value v = *--sp; *INDEX(base,size) = v; NEXT; }
+L_STOREX_F: { int base = code[pc++], size = code[pc++]; double v = (--sp)->d; INDEX(base,size)->d = (float)v; NEXT; }
+L_STOREX_C: { int base = code[pc++], size = code[pc++]; int v = (--sp)->i; INDEX(base,size)->i = (char)v; NEXT; }
+L_ADD_I: BIN_I((int)((unsigned)a+(unsigned)b))
+L_SUB_I: BIN_I((int)((unsigned)a-(unsigned)b))
+L_MUL_I: BIN_I((int)((unsigned)a*(unsigned)b))
+L_DIV_I: {
+    int b = (--sp)->i;
+    if(b==0) vmError("division par zero");
+    if(b==-1) sp[-1].i = (int)(0u-(unsigned)sp[-1].i);
+    else sp[-1].i /= b;
+    NEXT;
+}
+L_ADD_D: BIN_D(a+b)
+L_SUB_D: BIN_D(a-b)
+L_MUL_D: BIN_D(a*b)
+L_DIV_D: BIN_D(a/b)
+L_EQ_I: BIN_I(a==b)
+L_NE_I: BIN_I(a!=b)
+L_LT_I: BIN_I(a<b)
+L_GT_I: BIN_I(a>b)
+L_LE_I: BIN_I(a<=b)
+L_GE_I: BIN_I(a>=b)
+L_EQ_D: CMP_D(a==b)
+L_NE_D: CMP_D(a!=b)
+L_LT_D: CMP_D(a<b)
+L_GT_D: CMP_D(a>b)
+L_LE_D: CMP_D(a<=b)
+L_GE_D: CMP_D(a>=b)
+L_ROUND_F: sp[-1].d = (float)sp[-1].d; NEXT;
+L_TO_C: sp[-1].i = (char)sp[-1].i; NEXT;
+L_D2I: sp[-1].i = (int)sp[-1].d; NEXT;
+L_JMP: pc = code[pc]; NEXT;
+L_JZ: pc = (--sp)->i ? pc+1 : code[pc]; NEXT;
+L_JNZ: pc = (--sp)->i ? code[pc] : pc+1; NEXT;
+L_CALL: {
+    BcFunc *f = &cc->bc->funcs[code[pc++]];
+    if(depth==frameCap){
+        frameCap *= 2;
+        frames = realloc(frames,frameCap*sizeof(VmFrame));
+        if(!frames) vmError("memoire insuffisante");
+    }
+    Value *nfp = sp-f->nparams;
+    if(nfp+f->nslots+f->maxDepth > stackEnd) vmError("pile d'execution saturee");
+    frames[depth].pc = pc;
+    frames[depth].fp = fp;
+    depth++;
+    fp = nfp;
+    sp = fp+f->nslots;
+    memset(fp+f->nparams,0,(f->nslots-f->nparams)*sizeof(Value));
+    pc = f->entry;
+    NEXT;
+}
+L_RET: {
+    Value v = *--sp;
+    sp = fp;
+    depth--;
+    fp = frames[depth].fp;
+    pc = frames[depth].pc;
+    *sp++ = v;
+    NEXT;
+}
+L_INC: fp[code[pc++]].i++; NEXT;
+L_PRINT_I: printf("%d\n",(--sp)->i); NEXT;
+L_PRINT_D: printf("%f\n",(--sp)->d); NEXT;
+L_PRINT_C: printf("%c\n",(--sp)->i); NEXT;
+L_PRINT_S: fputs(cc->bc->strs[code[pc++]],stdout); NEXT;
+L_READ_I: { int v; if(scanf("%d",&v)==1) fp[code[pc]].i = v; pc++; NEXT; }
+L_READ_F: { float v; if(scanf("%f",&v)==1) fp[code[pc]].d = v; pc++; NEXT; }
+L_READ_C: { char v; if(scanf(" %c",&v)==1) fp[code[pc]].i = v; pc++; NEXT; }
+L_READX_I: { int base = code[pc++], size = code[pc++]; Value *p = INDEX(base,size); int v; if(scanf("%d",&v)==1) p->i = v; NEXT; }
+L_READX_F: { int base = code[pc++], size = code[pc++]; Value *p = INDEX(base,size); float v; if(scanf("%f",&v)==1) p->d = v; NEXT; }
+L_READX_C: { int base = code[pc++], size = code[pc++]; Value *p = INDEX(base,size); char v; if(scanf(" %c",&v)==1) p->i = v; NEXT; }
+L_HALT:
+    free(stack);
+    free(frames);
+    fflush(stdout);
+    return 0;
+
+#undef NEXT
+#undef INDEX
+#undef BIN_I
+#undef BIN_D
+#undef CMP_D
+}
+
+/* ---------- Generation assembleur x86-64 (--asm) ---------- */
+
+/* Le programme est traduit directement en assembleur GNU (syntaxe AT&T),
+   sans passer par le compilateur C, puis assemble et lie par as et ld avec
+   un petit runtime a appels systeme pour ECRIRE et LIRE (pas de libc).
+
+   Registres: les variables scalaires recoivent un registre par balayage
+   lineaire de leurs intervalles de vie, numerotes dans l'ordre de l'arbre.
+   Une variable utilisee dans une boucle vit sur toute la boucle. Un
+   intervalle qui traverse un appel (fonction ou runtime) ne peut prendre
+   qu'un registre preserve par l'appele (rbx, r12-r15); les FLOAT, pour
+   lesquels SysV n'en a pas, restent alors en memoire. Les autres
+   intervalles prennent aussi r8-r11, rsi, rdi ou xmm8-xmm15. Les tableaux
+   et les variables sans registre sont dans le cadre (rbp).
+
+   Expressions: INT et CHAR dans eax (CHAR etendu en signe), FLOAT en double
+   dans xmm0, arrondis en float comme le ferait le C (voir la VM); les
+   resultats intermediaires sont empiles. Appels: convention SysV, float
+   passes en simple precision, resultat int dans eax. */
+int asmMode = 0;
+
+static const char *const gpr64[] = {
+    "%rax","%rcx","%rdx","%rbx","%rsp","%rbp","%rsi","%rdi",
+    "%r8","%r9","%r10","%r11","%r12","%r13","%r14","%r15" };
+static const char *const gpr32[] = {
+    "%eax","%ecx","%edx","%ebx","%esp","%ebp","%esi","%edi",
+    "%r8d","%r9d","%r10d","%r11d","%r12d","%r13d","%r14d","%r15d" };
+static const char *const xmmRegs[] = {
+    "%xmm0","%xmm1","%xmm2","%xmm3","%xmm4","%xmm5","%xmm6","%xmm7",
+    "%xmm8","%xmm9","%xmm10","%xmm11","%xmm12","%xmm13","%xmm14","%xmm15" };
+
+static const int calleeSaved[] = { 3, 12, 13, 14, 15 };   // rbx, r12-r15
+static const int callerSaved[] = { 10, 11, 8, 9, 6, 7 };  // r10, r11, r8, r9, rsi, rdi
+static const int intArgRegs[] = { 7, 6, 2, 1, 8, 9 };     // rdi, rsi, rdx, rcx, r8, r9
+
+typedef struct {
+    Symbol *sym;
+    int start, end;
+    int crossesCall;
+} LiveInterval;
+
+typedef struct { int start, end; } LoopRange;
+
+typedef struct {
+    LiveInterval *iv;
+    int count, cap;
+    int *calls;             // positions des appels, croissantes
+    int ncalls, capCalls;
+    LoopRange *loops;
+    int nloops, capLoops;
+    int pos;
+} LiveScan;
+
+// Litteraux FLOAT et chaines d'ECRIRE, ecrits en .rodata a la fin
+struct AsmState {
+    double *reals;
+    int nreals, capReals;
+    const char **strs;
+    int nstrs, capStrs;
+    int labels;             // compteur des etiquettes .L
+    int retLabel;           // epilogue de la fonction en cours
+};
+
+/* Ligne d'assembleur sans passer par printf: '@' est remplace par une
+   chaine, '#' par un entier. */
+void asmLine(const char *fmt, ...){
+    va_list ap;
+    va_start(ap,fmt);
+    outStr("    ");
+    for(const char *p=fmt;*p;p++){
+        if(*p=='@') outStr(va_arg(ap,const char*));
+        else if(*p=='#') outInt(va_arg(ap,int));
+        else outChar(*p);
+    }
+    outChar('\n');
+    va_end(ap);
+}
+
+void asmLabel(int label){
+    outStr(".L");
+    outInt(label);
+    outStr(":\n");
+}
+
+int asmNewLabel(){
+    return cc->asmState->labels++;
+}
+
+// Emplacement d'une variable: registre 32 bits ou case du cadre
+const char *asmLoc(Symbol *s){
+    static _Thread_local char buf[4][24];
+    static _Thread_local int next;
+    if(s->reg>=0) return s->vtype==TYPE_FLOAT ? xmmRegs[s->reg] : gpr32[s->reg];
+    char *b = buf[next++ & 3];
+    snprintf(b,sizeof(buf[0]),"-%d(%%rbp)",s->slot);
+    return b;
+}
+
+/* ----- Intervalles de vie ----- */
+
+void liveUse(LiveScan *ls, Symbol *s){
+    if(s->arraySize>0) return;
+    if(!s->reg){
+        if(ls->count==ls->cap) ls->iv = growArray(ls->iv,&ls->cap,sizeof(LiveInterval));
+        ls->iv[ls->count] = (LiveInterval){ s, ls->pos, ls->pos, 0 };
+        s->reg = ++ls->count;
+    }
+    LiveInterval *it = &ls->iv[s->reg-1];
+    if(ls->pos<it->start) it->start = ls->pos;
+    if(ls->pos>it->end) it->end = ls->pos;
+}
+
+void liveCall(LiveScan *ls){
+    if(ls->ncalls==ls->capCalls) ls->calls = growArray(ls->calls,&ls->capCalls,sizeof(int));
+    ls->calls[ls->ncalls++] = ls->pos++;
+}
+
+void liveLoop(LiveScan *ls, int start){
+    if(ls->nloops==ls->capLoops) ls->loops = growArray(ls->loops,&ls->capLoops,sizeof(LoopRange));
+    ls->loops[ls->nloops++] = (LoopRange){ start, ls->pos++ };
+}
+
+void liveExpr(LiveScan *ls, Node *n){
+    switch(n->kind){
+        case N_VAR:
+            liveUse(ls,n->sym);
+            ls->pos++;
+            break;
+        case N_INDEX:
+            liveExpr(ls,n->a);
+            break;
+        case N_APPEL:
+            for(Node *arg=n->a;arg;arg=arg->next)
+                liveExpr(ls,arg);
+            liveCall(ls);
+            break;
+        case N_BINOP:
+            liveExpr(ls,n->a);
+            liveExpr(ls,n->b);
+            break;
+        default:
+            break;
+    }
+}
+
+void liveCible(LiveScan *ls, Node *cible){
+    if(cible->kind==N_INDEX) liveExpr(ls,cible->a);
+    else {
+        liveUse(ls,cible->sym);
+        ls->pos++;
+    }
+}
+
+void liveBloc(LiveScan *ls, Node *list){
+    for(Node *n=list;n;n=n->next){
+        int start = ls->pos;
+        switch(n->kind){
+            case N_AFFECT:
+                if(n->a->kind==N_INDEX) liveExpr(ls,n->a->a);
+                liveExpr(ls,n->b);
+                if(n->a->kind==N_VAR) liveCible(ls,n->a);
+                break;
+            case N_RETOURNER:
+                liveExpr(ls,n->a);
+                break;
+            case N_ECRIRE:
+                if(n->a->kind!=N_STRING) liveExpr(ls,n->a);
+                liveCall(ls);
+                break;
+            case N_LIRE:
+                liveCible(ls,n->a);
+                liveCall(ls);
+                liveCible(ls,n->a);
+                break;
+            case N_POUR:
+                liveExpr(ls,n->b);
+                liveCible(ls,n->a);
+                start = ls->pos;
+                liveExpr(ls,n->c);
+                liveBloc(ls,n->d);
+                liveCible(ls,n->a);
+                liveLoop(ls,start);
+                break;
+            case N_TANTQUE:
+            case N_REPETER:
+                liveExpr(ls,n->a);
+                liveBloc(ls,n->d);
+                liveLoop(ls,start);
+                break;
+            case N_SI:
+                liveExpr(ls,n->a);
+                liveBloc(ls,n->b);
+                liveBloc(ls,n->c);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int compareIntervals(const void *a, const void *b){
+    const LiveInterval *x = a, *y = b;
+    return x->start!=y->start ? (x->start<y->start ? -1 : 1) : (x->end<y->end ? -1 : x->end>y->end);
+}
+
+// Une variable lue ou ecrite dans une boucle doit survivre a toute la boucle
+void extendOverLoops(LiveScan *ls){
+    for(int changed=1;changed;){
+        changed = 0;
+        for(int k=0;k<ls->nloops;k++){
+            LoopRange *l = &ls->loops[k];
+            for(int i=0;i<ls->count;i++){
+                LiveInterval *it = &ls->iv[i];
+                if(it->start>l->end || it->end<l->start) continue;
+                if(it->start>l->start){ it->start = l->start; changed = 1; }
+                if(it->end<l->end){ it->end = l->end; changed = 1; }
+            }
+        }
+    }
+    for(int i=0;i<ls->count;i++){
+        LiveInterval *it = &ls->iv[i];
+        int lo = 0, hi = ls->ncalls;   // premier appel apres le debut
+        while(lo<hi){
+            int mid = (lo+hi)/2;
+            if(ls->calls[mid]<=it->start) lo = mid+1;
+            else hi = mid;
+        }
+        it->crossesCall = lo<ls->ncalls && ls->calls[lo]<it->end;
+    }
+}
+
+int isCalleeSaved(int reg){
+    for(int k=0;k<5;k++) if(calleeSaved[k]==reg) return 1;
+    return 0;
+}
+
+int regAllowed(LiveInterval *it, int reg){
+    if(it->sym->vtype==TYPE_FLOAT) return !it->crossesCall;
+    return isCalleeSaved(reg) || !it->crossesCall;
+}
+
+/* Balayage lineaire (Poletto et Sarkar): intervalles par debut croissant;
+   sans registre libre, celui des actifs qui finit le plus tard est vide en
+   memoire s'il finit apres le nouveau. Renvoie les registres preserves
+   utilises, a sauvegarder dans le prologue. */
+unsigned linearScan(LiveScan *ls){
+    qsort(ls->iv,ls->count,sizeof(LiveInterval),compareIntervals);
+    for(int i=0;i<ls->count;i++) ls->iv[i].sym->reg = -1;
+
+    int *active = calloc(ls->count+1,sizeof(int));
+    if(!active) fatal("memoire insuffisante");
+    int nactive = 0;
+    unsigned busyGpr = 0, busyXmm = 0, usedCallee = 0;
+
+    for(int i=0;i<ls->count;i++){
+        LiveInterval *it = &ls->iv[i];
+        int isFloat = it->sym->vtype==TYPE_FLOAT;
+
+        int k = 0;
+        for(int a=0;a<nactive;a++){
+            LiveInterval *old = &ls->iv[active[a]];
+            if(old->end<it->start){
+                if(old->sym->reg>=0){
+                    if(old->sym->vtype==TYPE_FLOAT) busyXmm &= ~(1u<<old->sym->reg);
+                    else busyGpr &= ~(1u<<old->sym->reg);
+                }
+            }
+            else active[k++] = active[a];
+        }
+        nactive = k;
+
+        int reg = -1;
+        if(isFloat){
+            for(int r=8;r<16 && reg<0 && !it->crossesCall;r++)
+                if(!(busyXmm&(1u<<r))) reg = r;
+        } else {
+            for(int r=0;r<6 && reg<0 && !it->crossesCall;r++)
+                if(!(busyGpr&(1u<<callerSaved[r]))) reg = callerSaved[r];
+            for(int r=0;r<5 && reg<0;r++)
+                if(!(busyGpr&(1u<<calleeSaved[r]))) reg = calleeSaved[r];
+        }
+        if(reg<0){
+            int victim = -1;
+            for(int a=0;a<nactive;a++){
+                LiveInterval *v = &ls->iv[active[a]];
+                if(v->sym->reg<0 || (v->sym->vtype==TYPE_FLOAT)!=isFloat || !regAllowed(it,v->sym->reg)) continue;
+                if(victim<0 || v->end>ls->iv[active[victim]].end) victim = a;
+            }
+            if(victim>=0 && ls->iv[active[victim]].end>it->end){
+                Symbol *v = ls->iv[active[victim]].sym;
+                reg = v->reg;
+                v->reg = -1;
+            }
+        }
+        if(reg>=0){
+            if(isFloat) busyXmm |= 1u<<reg;
+            else {
+                busyGpr |= 1u<<reg;
+                if(isCalleeSaved(reg)) usedCallee |= 1u<<reg;
+            }
+        }
+        it->sym->reg = reg;
+        active[nactive++] = i;
+    }
+    free(active);
+    return usedCallee;
+}
+
+/* ----- Expressions ----- */
+
+typedef enum { AT_INT, AT_FLOAT, AT_DOUBLE } AsmType;   // comme CType pour la VM
+
+int asmReal(double v){
+    AsmState *st = cc->asmState;
+    if(st->nreals==st->capReals) st->reals = growArray(st->reals,&st->capReals,sizeof(double));
+    st->reals[st->nreals] = v;
+    return st->nreals++;
+}
+
+const char *asmRealRef(double v){
+    static _Thread_local char buf[2][24];
+    static _Thread_local int next;
+    char *b = buf[next++ & 1];
+    snprintf(b,sizeof(buf[0]),".LR%d(%%rip)",asmReal(v));
+    return b;
+}
+
+void asmPush(AsmType t){
+    if(t==AT_INT) asmLine("pushq %rax");
+    else {
+        asmLine("subq $8, %rsp");
+        asmLine("movsd %xmm0, (%rsp)");
+    }
+}
+
+// Operande directe d'une operation INT (immediat, registre ou case INT), sinon NULL
+const char *asmIntOperand(Node *n){
+    static _Thread_local char buf[2][24];
+    static _Thread_local int next;
+    if(n->kind==N_NUM || n->kind==N_CHAR_LIT){
+        char *b = buf[next++ & 1];
+        snprintf(b,sizeof(buf[0]),"$%d",n->kind==N_NUM ? (int)intValue(n) : (signed char)n->tok.text[0]);
+        return b;
+    }
+    if(n->kind==N_VAR && (n->sym->reg>=0 || n->sym->vtype==TYPE_INT)) return asmLoc(n->sym);
+    return NULL;
+}
+
+// Litteral ou variable: evalue sans toucher a rcx
+int isLeaf(Node *n){
+    return n->kind==N_NUM || n->kind==N_CHAR_LIT || n->kind==N_REEL || n->kind==N_VAR;
+}
+
+// Adresse d'un element; l'indice non constant est dans rcx (etendu en 64 bits)
+const char *asmElem(Symbol *s, Node *index){
+    static _Thread_local char buf[2][40];
+    static _Thread_local int next;
+    char *b = buf[next++ & 1];
+    int size = s->vtype==TYPE_CHAR ? 1 : 4;
+    if(index && index->kind==N_NUM)
+        snprintf(b,sizeof(buf[0]),"%lld(%%rbp)",(long long)intValue(index)*size-s->slot);
+    else
+        snprintf(b,sizeof(buf[0]),"-%d(%%rbp,%%rcx,%d)",s->slot,size);
+    return b;
+}
+
+AsmType asmExpr(Node *n);
+
+// Indice d'un element dans rcx, sauf s'il est constant
+void asmIndex(Node *cible){
+    if(cible->a->kind==N_NUM) return;
+    asmExpr(cible->a);
+    asmLine("movslq %eax, %rcx");
+}
+
+void asmLoad(Symbol *s, const char *at){
+    if(s->vtype==TYPE_FLOAT){
+        if(s->reg>=0) asmLine("movapd @, %xmm0",at);
+        else asmLine("cvtss2sd @, %xmm0",at);
+    }
+    else if(s->vtype==TYPE_CHAR && s->reg<0) asmLine("movsbl @, %eax",at);
+    else asmLine("movl @, %eax",at);
+}
+
+// Range eax ou xmm0 dans la variable ou l'element, converti comme en C
+void asmStore(Symbol *s, const char *at){
+    if(s->vtype==TYPE_FLOAT){
+        if(s->reg>=0){
+            asmLine("cvtsd2ss %xmm0, @",at);
+            asmLine("cvtss2sd @, @",at,at);
+        } else {
+            asmLine("cvtsd2ss %xmm0, %xmm0");
+            asmLine("movss %xmm0, @",at);
+        }
+    }
+    else if(s->vtype==TYPE_CHAR){
+        if(s->reg>=0) asmLine("movsbl %al, @",at);
+        else asmLine("movb %al, @",at);
+    }
+    else asmLine("movl %eax, @",at);
+}
+
+static const char *const intSetcc[] = { "sete", "setne", "setl", "setg", "setle", "setge" };
+static const char *const intJcc[] = { "je", "jne", "jl", "jg", "jle", "jge" };
+static const char *const intJncc[] = { "jne", "je", "jge", "jle", "jg", "jl" };
+
+/* Operandes INT de n: la gauche dans eax, la droite renvoyee comme operande
+   directe, ou dans ecx apres passage par la pile. */
+const char *asmIntOperands(Node *n){
+    int leaf = asmIntOperand(n->b)!=NULL;
+    asmExpr(n->a);
+    if(leaf) return asmIntOperand(n->b);
+    asmLine("pushq %rax");
+    asmExpr(n->b);
+    asmLine("movl %eax, %ecx");
+    asmLine("popq %rax");
+    return "%ecx";
+}
+
+// Flags positionnes pour a op b
+void asmCompareInt(Node *n){
+    asmLine("cmpl @, %eax",asmIntOperands(n));
+}
+
+// Operandes FLOAT de n dans xmm0 (gauche) et xmm1 (droite)
+void asmFloatOperands(Node *n, AsmType *t1, AsmType *t2){
+    Node *b = n->b;
+    *t1 = asmExpr(n->a);
+    if(b->kind==N_REEL){
+        asmLine("movsd @, %xmm1",asmRealRef(realValue(b)));
+        *t2 = AT_DOUBLE;
+    } else if(b->kind==N_VAR){
+        if(b->sym->reg>=0) asmLine("movapd @, %xmm1",asmLoc(b->sym));
+        else asmLine("cvtss2sd @, %xmm1",asmLoc(b->sym));
+        *t2 = AT_FLOAT;
+    } else {
+        asmPush(AT_DOUBLE);
+        *t2 = asmExpr(b);
+        asmLine("movapd %xmm0, %xmm1");
+        asmLine("movsd (%rsp), %xmm0");
+        asmLine("addq $8, %rsp");
+    }
+}
+
+// Comparaison FLOAT dans eax; une operande NaN rend tout faux sauf !=
+void asmCompareFloat(Node *n){
+    AsmType t1, t2;
+    asmFloatOperands(n,&t1,&t2);
+    switch(n->op){
+        case TOK_EGAL:
+            asmLine("ucomisd %xmm1, %xmm0");
+            asmLine("sete %al");
+            asmLine("setnp %cl");
+            asmLine("andb %cl, %al");
+            break;
+        case TOK_DIFF:
+            asmLine("ucomisd %xmm1, %xmm0");
+            asmLine("setne %al");
+            asmLine("setp %cl");
+            asmLine("orb %cl, %al");
+            break;
+        case TOK_SUP: asmLine("ucomisd %xmm1, %xmm0"); asmLine("seta %al"); break;
+        case TOK_SUPEG: asmLine("ucomisd %xmm1, %xmm0"); asmLine("setae %al"); break;
+        case TOK_INF: asmLine("ucomisd %xmm0, %xmm1"); asmLine("seta %al"); break;
+        default: asmLine("ucomisd %xmm0, %xmm1"); asmLine("setae %al"); break;
+    }
+    asmLine("movzbl %al, %eax");
+}
+
+AsmType asmCall(Node *n){
+    Symbol *f = n->sym;
+    int nargs = f->paramCount, nint = 0, nfloat = 0, nstack = 0, k = 0;
+    for(Node *arg=n->a;arg;arg=arg->next){
+        asmExpr(arg);
+        VarType t = f->paramTypes[k++];
+        if(t==TYPE_FLOAT){
+            asmLine("cvtsd2ss %xmm0, %xmm0");
+            asmLine("movd %xmm0, %eax");
+        }
+        else if(t==TYPE_CHAR) asmLine("movsbl %al, %eax");
+        asmLine("pushq %rax");
+        if(t==TYPE_FLOAT ? nfloat<8 : nint<6){
+            if(t==TYPE_FLOAT) nfloat++;
+            else nint++;
+        }
+        else nstack++;
+    }
+
+    // Arguments empiles dans l'ordre: le k-ieme est a 8*(nargs-1-k)(%rsp)
+    int ki = 0, kf = 0;
+    k = 0;
+    for(Node *arg=n->a;arg;arg=arg->next,k++){
+        VarType t = f->paramTypes[k];
+        int at = 8*(nargs-1-k);
+        if(t==TYPE_FLOAT && kf<8) asmLine("movss #(%rsp), @",at,xmmRegs[kf++]);
+        else if(t!=TYPE_FLOAT && ki<6) asmLine("movq #(%rsp), @",at,gpr64[intArgRegs[ki++]]);
+    }
+    if(nstack){
+        asmLine("subq $#, %rsp",8*nstack);
+        ki = kf = k = 0;
+        int j = 0;
+        for(Node *arg=n->a;arg;arg=arg->next,k++){
+            VarType t = f->paramTypes[k];
+            if(t==TYPE_FLOAT ? kf++<8 : ki++<6) continue;
+            asmLine("movq #(%rsp), %rax",8*nstack+8*(nargs-1-k));
+            asmLine("movq %rax, #(%rsp)",8*j++);
+        }
+    }
+    asmLine("call fn_@",f->name);
+    if(nargs+nstack) asmLine("addq $#, %rsp",8*(nargs+nstack));
+    return AT_INT;
+}
+
+AsmType asmExpr(Node *n){
+    switch(n->kind){
+        case N_NUM:
+        case N_CHAR_LIT:
+            asmLine("movl @, %eax",asmIntOperand(n));
+            return AT_INT;
+        case N_REEL:
+            asmLine("movsd @, %xmm0",asmRealRef(realValue(n)));
+            return AT_DOUBLE;
+        case N_VAR:
+            asmLoad(n->sym,asmLoc(n->sym));
+            return n->sym->vtype==TYPE_FLOAT ? AT_FLOAT : AT_INT;
+        case N_INDEX:
+            asmIndex(n);
+            asmLoad(n->sym,asmElem(n->sym,n->a));
+            return n->sym->vtype==TYPE_FLOAT ? AT_FLOAT : AT_INT;
+        case N_APPEL:
+            return asmCall(n);
+        case N_BINOP: {
+            if(n->a->vtype==TYPE_FLOAT){
+                if(isComparison(n->op)){
+                    asmCompareFloat(n);
+                    return AT_INT;
+                }
+                AsmType t1, t2;
+                asmFloatOperands(n,&t1,&t2);
+                static const char *const ops[] = { "addsd", "subsd", "mulsd", "divsd" };
+                asmLine("@ %xmm1, %xmm0",ops[n->op-TOK_PLUS]);
+                if(t1==AT_FLOAT && t2==AT_FLOAT){
+                    asmLine("cvtsd2ss %xmm0, %xmm0");
+                    asmLine("cvtss2sd %xmm0, %xmm0");
+                    return AT_FLOAT;
+                }
+                return AT_DOUBLE;
+            }
+            if(isComparison(n->op)){
+                asmCompareInt(n);
+                asmLine("@ %al",intSetcc[n->op-TOK_EGAL]);
+                asmLine("movzbl %al, %eax");
+                return AT_INT;
+            }
+            const char *rhs = asmIntOperands(n);
+            switch(n->op){
+                case TOK_PLUS: asmLine("addl @, %eax",rhs); break;
+                case TOK_MOINS: asmLine("subl @, %eax",rhs); break;
+                case TOK_MUL: asmLine("imull @, %eax",rhs); break;
+                default:
+                    if(rhs[0]=='$'){
+                        asmLine("movl @, %ecx",rhs);
+                        rhs = "%ecx";
+                    }
+                    asmLine("cltd");
+                    asmLine("idivl @",rhs);
+                    break;
+            }
+            return AT_INT;
+        }
+        default:
+            return AT_INT;
+    }
+}
+
+// Saute a 'label' si la condition vaut 'when' (un FLOAT est compare a 0)
+void asmCond(Node *n, int label, int when){
+    if(n->kind==N_BINOP && isComparison(n->op) && n->a->vtype!=TYPE_FLOAT){
+        asmCompareInt(n);
+        asmLine("@ .L#",(when ? intJcc : intJncc)[n->op-TOK_EGAL],label);
+        return;
+    }
+    if(asmExpr(n)==AT_INT){
+        asmLine("testl %eax, %eax");
+        asmLine("@ .L#",when ? "jnz" : "jz",label);
+        return;
+    }
+    asmLine("xorpd %xmm1, %xmm1");
+    asmLine("ucomisd %xmm1, %xmm0");
+    if(when){
+        asmLine("jne .L#",label);
+        asmLine("jp .L#",label);
+    } else {
+        int skip = asmNewLabel();
+        asmLine("jp .L#",skip);
+        asmLine("je .L#",label);
+        asmLabel(skip);
+    }
+}
+
+/* ----- Instructions ----- */
+
+// Chaine d'ECRIRE: sequences d'echappement interpretees, saut de ligne final
+int asmString(const char *s){
+    AsmState *st = cc->asmState;
+    if(st->nstrs==st->capStrs) st->strs = growArray(st->strs,&st->capStrs,sizeof(char*));
+    st->strs[st->nstrs] = ecrireText(s);
+    return st->nstrs++;
+}
+
+// Affectation INT sans passer par eax (immediat ou registre vers la variable)
+int asmMoveInt(Symbol *s, Node *value){
+    if(s->vtype!=TYPE_INT || value->vtype!=TYPE_INT) return 0;
+    const char *op = asmIntOperand(value);
+    if(!op || (s->reg<0 && op[0]!='$' && op[0]!='%')) return 0;
+    asmLine("movl @, @",op,asmLoc(s));
+    return 1;
+}
+
+void asmBloc(Node *list);
+
+void asmInstr(Node *n){
+    switch(n->kind){
+        case N_AFFECT: {
+            Node *cible = n->a;
+            Symbol *s = cible->sym;
+            if(cible->kind==N_VAR){
+                if(asmMoveInt(s,n->b)) break;
+                asmExpr(n->b);
+                asmStore(s,asmLoc(s));
+            } else if(cible->a->kind==N_NUM || isLeaf(n->b)){
+                asmIndex(cible);
+                asmExpr(n->b);
+                asmStore(s,asmElem(s,cible->a));
+            } else {
+                asmIndex(cible);
+                asmLine("pushq %rcx");
+                asmExpr(n->b);
+                asmLine("popq %rcx");
+                asmStore(s,asmElem(s,cible->a));
+            }
+            break;
+        }
+
+        case N_RETOURNER:
+            if(asmExpr(n->a)!=AT_INT) asmLine("cvttsd2si %xmm0, %eax");
+            asmLine("jmp .L#",cc->asmState->retLabel);
+            break;
+
+        case N_ECRIRE:
+            if(n->a->kind==N_STRING){
+                int k = asmString(n->a->tok.text);
+                asmLine("leaq .LS#(%rip), %rsi",k);
+                asmLine("movl $#, %edx",(int)strlen(cc->asmState->strs[k]));
+                asmLine("call __algo_print_str");
+            }
+            else if(n->a->vtype==TYPE_FLOAT){
+                asmExpr(n->a);
+                asmLine("call __algo_print_double");
+            } else {
+                asmExpr(n->a);
+                asmLine("movl %eax, %edi");
+                asmLine(n->a->vtype==TYPE_CHAR ? "call __algo_print_char" : "call __algo_print_int");
+            }
+            break;
+
+        case N_LIRE: {
+            // scanf laisse la variable intacte si la lecture echoue (edx = 0)
+            Node *cible = n->a;
+            Symbol *s = cible->sym;
+            int indexed = cible->kind==N_INDEX && cible->a->kind!=N_NUM;
+            if(indexed){
+                asmIndex(cible);
+                asmLine("pushq %rcx");
+            }
+            asmLine(s->vtype==TYPE_FLOAT ? "call __algo_read_float" :
+                    s->vtype==TYPE_CHAR ? "call __algo_read_char" : "call __algo_read_int");
+            if(indexed) asmLine("popq %rcx");
+            int skip = asmNewLabel();
+            asmLine("testl %edx, %edx");
+            asmLine("jz .L#",skip);
+            asmStore(s,cible->kind==N_INDEX ? asmElem(s,cible->a) : asmLoc(s));
+            asmLabel(skip);
+            break;
+        }
+
+        case N_TANTQUE: {
+            int top = asmNewLabel(), test = asmNewLabel();
+            asmLine("jmp .L#",test);
+            asmLabel(top);
+            asmBloc(n->d);
+            asmLabel(test);
+            asmCond(n->a,top,1);
+            break;
+        }
+
+        case N_REPETER: {
+            int top = asmNewLabel();
+            asmLabel(top);
+            asmBloc(n->d);
+            asmCond(n->a,top,1);
+            break;
+        }
+
+        case N_POUR: {
+            // i <= fin, la borne etant reevaluee a chaque tour comme en C
+            Symbol *s = n->a->sym;
+            int top = asmNewLabel(), test = asmNewLabel();
+            if(!asmMoveInt(s,n->b)){
+                asmExpr(n->b);
+                asmStore(s,asmLoc(s));
+            }
+            asmLine("jmp .L#",test);
+            asmLabel(top);
+            asmBloc(n->d);
+            asmLine("addl $1, @",asmLoc(s));
+            asmLabel(test);
+            const char *fin = asmIntOperand(n->c);
+            if(!fin || (s->reg<0 && fin[0]!='$' && fin[0]!='%')){
+                asmExpr(n->c);
+                fin = "%eax";
+            }
+            asmLine("cmpl @, @",fin,asmLoc(s));
+            asmLine("jle .L#",top);
+            break;
+        }
+
+        case N_SI: {
+            int sinon = asmNewLabel();
+            asmCond(n->a,sinon,0);
+            asmBloc(n->b);
+            if(n->c){
+                int fin = asmNewLabel();
+                asmLine("jmp .L#",fin);
+                asmLabel(sinon);
+                asmBloc(n->c);
+                asmLabel(fin);
+            }
+            else asmLabel(sinon);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void asmBloc(Node *list){
+    for(Node *n=list;n;n=n->next)
+        asmInstr(n);
+}
+
+/* ----- Fonctions ----- */
+
+// Cases du cadre pour les tableaux et les scalaires sans registre
+int asmFrame(Node *decls, int offset){
+    for(Node *d=decls;d;d=d->next){
+        Symbol *s = d->sym;
+        if(d->arraySize>0){
+            int size = d->arraySize*(s->vtype==TYPE_CHAR ? 1 : 4);
+            offset = (offset+size+7) & ~7;
+            s->slot = offset;
+        }
+        else if(s->reg<0){
+            offset += 8;
+            s->slot = offset;
+        }
+    }
+    return offset;
+}
+
+// name: NULL pour le programme principal
+void asmFunction(const char *name, Node *params, Node *decls, Node *body){
+    LiveScan ls;
+    memset(&ls,0,sizeof(ls));
+    for(Node *p=params;p;p=p->next) p->sym->reg = 0;
+    for(Node *d=decls;d;d=d->next) d->sym->reg = 0;
+
+    for(Node *p=params;p;p=p->next) liveUse(&ls,p->sym);
+    ls.pos = 1;
+    liveBloc(&ls,body);
+    extendOverLoops(&ls);
+    unsigned usedCallee = linearScan(&ls);
+    for(Node *d=decls;d;d=d->next) if(d->sym->reg==0) d->sym->reg = -1;   // tableau, ou jamais utilisee
+    free(ls.iv);
+    free(ls.calls);
+    free(ls.loops);
+
+    // Cadre: registres preserves, parametres et variables en memoire, tableaux
+    int offset = 0, saves[5], nsaves = 0;
+    for(int k=0;k<5;k++)
+        if(usedCallee&(1u<<calleeSaved[k])){
+            offset += 8;
+            saves[nsaves++] = calleeSaved[k];
+        }
+    offset = asmFrame(decls,asmFrame(params,offset));
+    offset = (offset+15) & ~15;
+
+    if(name){
+        outStr("\nfn_");
+        outStr(name);
+    }
+    else outStr("\n__algo_main");
+    outStr(":\n");
+    asmLine("pushq %rbp");
+    asmLine("movq %rsp, %rbp");
+    if(offset) asmLine("subq $#, %rsp",offset);
+    for(int k=0;k<nsaves;k++)
+        asmLine("movq @, -#(%rbp)",gpr64[saves[k]],8*(k+1));
+
+    /* Parametres: tous les registres d'arrivee sont d'abord empiles, un
+       parametre peut recevoir le registre d'arrivee d'un autre. */
+    int ni = 0, nf = 0, nstack = 0, np = 0;
+    for(Node *p=params;p;p=p->next){
+        if(p->vtype==TYPE_FLOAT && nf<8){
+            asmLine("subq $8, %rsp");
+            asmLine("movss @, (%rsp)",xmmRegs[nf++]);
+            np++;
+        }
+        else if(p->vtype!=TYPE_FLOAT && ni<6){
+            asmLine("pushq @",gpr64[intArgRegs[ni++]]);
+            np++;
+        }
+    }
+    ni = nf = 0;
+    int k = 0;
+    for(Node *p=params;p;p=p->next){
+        Symbol *s = p->sym;
+        char from[24];
+        if(p->vtype==TYPE_FLOAT ? nf++<8 : ni++<6)
+            snprintf(from,sizeof(from),"%d(%%rsp)",8*(np-1-k++));
+        else
+            snprintf(from,sizeof(from),"%d(%%rbp)",16+8*nstack++);
+        if(p->vtype==TYPE_FLOAT) asmLine("cvtss2sd @, %xmm0",from);
+        else asmLine("movl @, %eax",from);
+        asmStore(s,asmLoc(s));
+    }
+    if(np) asmLine("addq $#, %rsp",8*np);
+
+    cc->asmState->retLabel = asmNewLabel();
+    asmBloc(body);
+    asmLine("xorl %eax, %eax");
+    asmLabel(cc->asmState->retLabel);
+    for(int j=0;j<nsaves;j++)
+        asmLine("movq -#(%rbp), @",8*(j+1),gpr64[saves[j]]);
+    asmLine("leave");
+    asmLine("ret");
+}
+
+/* ----- Runtime ----- */
+
+/* Point d'entree et E/S par appels systeme, sans libc: sortie tamponnee
+   (videe a la fin et avant chaque lecture, comme stdout sur un terminal),
+   entree tamponnee lue comme scanf. Les routines peuvent detruire tous les
+   registres non preserves: leurs appels comptent comme des appels pour les
+   intervalles de vie. Les FLOAT sont ecrits exactement comme printf("%f"):
+   la valeur binaire est developpee en decimal puis arrondie au pair. */
+static const char asmRuntime[] =
+    "\n    .text\n"
+    "    .globl _start\n"
+    "_start:\n"
+    "    call __algo_main\n"
+    "    call __algo_flush\n"
+    "    movl $60, %eax\n"
+    "    xorl %edi, %edi\n"
+    "    syscall\n"
+    "\n"
+    "# Vide le tampon de sortie; preserve rdi, rsi et rdx\n"
+    "__algo_flush:\n"
+    "    pushq %rdi\n"
+    "    pushq %rsi\n"
+    "    pushq %rdx\n"
+    "    movq __algo_outlen(%rip), %rdx\n"
+    "    leaq __algo_outbuf(%rip), %rsi\n"
+    "1:  testq %rdx, %rdx\n"
+    "    jz 2f\n"
+    "    movl $1, %edi\n"
+    "    movl $1, %eax\n"
+    "    syscall\n"
+    "    cmpq $-4, %rax\n"              // EINTR
+    "    je 1b\n"
+    "    testq %rax, %rax\n"
+    "    jle 2f\n"
+    "    addq %rax, %rsi\n"
+    "    subq %rax, %rdx\n"
+    "    jmp 1b\n"
+    "2:  movq $0, __algo_outlen(%rip)\n"
+    "    popq %rdx\n"
+    "    popq %rsi\n"
+    "    popq %rdi\n"
+    "    ret\n"
+    "\n"
+    "# Ajoute l'octet dil au tampon\n"
+    "__algo_putc:\n"
+    "    movq __algo_outlen(%rip), %rax\n"
+    "    cmpq $65536, %rax\n"
+    "    jb 1f\n"
+    "    call __algo_flush\n"
+    "    xorl %eax, %eax\n"
+    "1:  leaq __algo_outbuf(%rip), %rcx\n"
+    "    movb %dil, (%rcx,%rax)\n"
+    "    incq %rax\n"
+    "    movq %rax, __algo_outlen(%rip)\n"
+    "    ret\n"
+    "\n"
+    "# rdx octets a partir de rsi\n"
+    "__algo_print_str:\n"
+    "    movq %rsi, %r8\n"
+    "    movq %rdx, %r9\n"
+    "1:  testq %r9, %r9\n"
+    "    jz 2f\n"
+    "    movzbl (%r8), %edi\n"
+    "    call __algo_putc\n"
+    "    incq %r8\n"
+    "    decq %r9\n"
+    "    jmp 1b\n"
+    "2:  ret\n"
+    "\n"
+    "# printf(\"%d\\n\", edi)\n"
+    "__algo_print_int:\n"
+    "    subq $40, %rsp\n"
+    "    movslq %edi, %rax\n"
+    "    movq %rax, %r10\n"
+    "    leaq 32(%rsp), %r8\n"
+    "    movb $10, (%r8)\n"
+    "    movq %r8, %r9\n"
+    "    testq %rax, %rax\n"
+    "    jns 1f\n"
+    "    negq %rax\n"
+    "1:  movl $10, %ecx\n"
+    "2:  xorl %edx, %edx\n"
+    "    divq %rcx\n"
+    "    addb $48, %dl\n"
+    "    decq %r9\n"
+    "    movb %dl, (%r9)\n"
+    "    testq %rax, %rax\n"
+    "    jnz 2b\n"
+    "    testq %r10, %r10\n"
+    "    jns 3f\n"
+    "    decq %r9\n"
+    "    movb $45, (%r9)\n"
+    "3:  movq %r9, %rsi\n"
+    "    leaq 1(%r8), %rdx\n"
+    "    subq %r9, %rdx\n"
+    "    call __algo_print_str\n"
+    "    addq $40, %rsp\n"
+    "    ret\n"
+    "\n"
+    "# printf(\"%c\\n\", edi)\n"
+    "__algo_print_char:\n"
+    "    call __algo_putc\n"
+    "    movl $10, %edi\n"
+    "    jmp __algo_putc\n"
+    "\n"
+    "# printf(\"%f\\n\", xmm0): m*2^e developpe dans __algo_digits, un chiffre\n"
+    "# par octet, poids faibles d'abord; 'point' chiffres apres la virgule\n"
+    "__algo_print_double:\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    movq %xmm0, %r13\n"
+    "    movq %r13, %rbx\n"
+    "    shrq $52, %rbx\n"
+    "    andl $0x7ff, %ebx\n"
+    "    movq %r13, %r12\n"
+    "    shlq $12, %r12\n"
+    "    shrq $12, %r12\n"
+    "    testq %r13, %r13\n"
+    "    jns 1f\n"
+    "    movl $45, %edi\n"
+    "    call __algo_putc\n"
+    "1:  cmpl $0x7ff, %ebx\n"
+    "    jne .Lpd_finite\n"
+    "    leaq __algo_inf(%rip), %rsi\n"
+    "    testq %r12, %r12\n"
+    "    jz 2f\n"
+    "    leaq __algo_nan(%rip), %rsi\n"
+    "2:  movl $4, %edx\n"
+    "    call __algo_print_str\n"
+    "    jmp .Lpd_done\n"
+    ".Lpd_finite:\n"
+    "    testl %ebx, %ebx\n"
+    "    jz 1f\n"
+    "    btsq $52, %r12\n"
+    "    subl $1075, %ebx\n"
+    "    jmp 2f\n"
+    "1:  movl $-1074, %ebx\n"
+    "2:  leaq __algo_digits(%rip), %rdi\n"
+    "    xorl %ecx, %ecx\n"             // rcx: nombre de chiffres
+    "    movq %r12, %rax\n"
+    "    movl $10, %r8d\n"
+    "3:  xorl %edx, %edx\n"
+    "    divq %r8\n"
+    "    movb %dl, (%rdi,%rcx)\n"
+    "    incq %rcx\n"
+    "    testq %rax, %rax\n"
+    "    jnz 3b\n"
+    // e >= 0: e fois *2; e < 0: -e fois *5 et autant de chiffres apres la virgule
+    "    xorl %r9d, %r9d\n"             // r9: point
+    "    movl $2, %r8d\n"
+    "    movl %ebx, %r10d\n"
+    "    testl %ebx, %ebx\n"
+    "    jns .Lpd_scale\n"
+    "    movl $5, %r8d\n"
+    "    negl %r10d\n"
+    "    movl %r10d, %r9d\n"
+    ".Lpd_scale:\n"
+    "    testl %r10d, %r10d\n"
+    "    jz .Lpd_round\n"
+    "    xorl %edx, %edx\n"
+    "    xorl %esi, %esi\n"
+    "1:  movzbl (%rdi,%rsi), %eax\n"
+    "    imull %r8d, %eax\n"
+    "    addl %edx, %eax\n"
+    "    imull $205, %eax, %edx\n"      // x/10 pour x < 1029
+    "    shrl $11, %edx\n"
+    "    leal (%rdx,%rdx,4), %r11d\n"
+    "    addl %r11d, %r11d\n"
+    "    subl %r11d, %eax\n"
+    "    movb %al, (%rdi,%rsi)\n"
+    "    incq %rsi\n"
+    "    cmpq %rcx, %rsi\n"
+    "    jb 1b\n"
+    "    testl %edx, %edx\n"
+    "    jz 2f\n"
+    "    movb %dl, (%rdi,%rcx)\n"
+    "    incq %rcx\n"
+    "2:  decl %r10d\n"
+    "    jmp .Lpd_scale\n"
+    // Plus de 6 chiffres apres la virgule: arrondi au plus proche, egalite au pair
+    ".Lpd_round:\n"
+    "    cmpq $6, %r9\n"
+    "    jbe .Lpd_pad\n"
+    "    movq %r9, %r10\n"
+    "    subq $6, %r10\n"               // r10: chiffres abandonnes
+    "    leaq -1(%r10), %rsi\n"
+    "    xorl %eax, %eax\n"             // eax: premier chiffre abandonne
+    "    cmpq %rcx, %rsi\n"
+    "    jae 1f\n"
+    "    movzbl (%rdi,%rsi), %eax\n"
+    "1:  movq %rsi, %r11\n"
+    "    cmpq %rcx, %r11\n"
+    "    jbe 2f\n"
+    "    movq %rcx, %r11\n"
+    "2:  xorl %edx, %edx\n"             // dl: reste non nul apres le premier abandonne
+    "    xorl %esi, %esi\n"
+    "3:  cmpq %r11, %rsi\n"
+    "    jae 4f\n"
+    "    orb (%rdi,%rsi), %dl\n"
+    "    incq %rsi\n"
+    "    jmp 3b\n"
+    "4:  xorl %r8d, %r8d\n"             // r8: dernier chiffre garde
+    "    cmpq %rcx, %r10\n"
+    "    jae 5f\n"
+    "    movzbl (%rdi,%r10), %r8d\n"
+    "5:  xorl %ebx, %ebx\n"             // ebx: arrondi vers le haut
+    "    cmpl $5, %eax\n"
+    "    jb 7f\n"
+    "    ja 6f\n"
+    "    testb %dl, %dl\n"
+    "    jnz 6f\n"
+    "    testl $1, %r8d\n"
+    "    jz 7f\n"
+    "6:  movl $1, %ebx\n"
+    "7:  cmpq %rcx, %r10\n"
+    "    jb 8f\n"
+    "    movb $0, (%rdi)\n"
+    "    movl $1, %ecx\n"
+    "    jmp .Lpd_carry\n"
+    "8:  xorl %esi, %esi\n"
+    "    movq %rcx, %r11\n"
+    "    subq %r10, %r11\n"
+    "9:  movb (%rdi,%r10), %al\n"
+    "    movb %al, (%rdi,%rsi)\n"
+    "    incq %rsi\n"
+    "    incq %r10\n"
+    "    cmpq %r11, %rsi\n"
+    "    jb 9b\n"
+    "    movq %r11, %rcx\n"
+    ".Lpd_carry:\n"
+    "    testl %ebx, %ebx\n"
+    "    jz .Lpd_print\n"
+    "    xorl %esi, %esi\n"
+    "1:  cmpq %rcx, %rsi\n"
+    "    jb 2f\n"
+    "    movb $1, (%rdi,%rcx)\n"
+    "    incq %rcx\n"
+    "    jmp .Lpd_print\n"
+    "2:  incb (%rdi,%rsi)\n"
+    "    cmpb $10, (%rdi,%rsi)\n"
+    "    jb .Lpd_print\n"
+    "    movb $0, (%rdi,%rsi)\n"
+    "    incq %rsi\n"
+    "    jmp 1b\n"
+    // Moins de 6 chiffres apres la virgule: zeros ajoutes a droite
+    ".Lpd_pad:\n"
+    "    movl $6, %r10d\n"
+    "    subl %r9d, %r10d\n"
+    "    jz .Lpd_print\n"
+    "    leaq (%rdi,%r10), %r11\n"
+    "    movq %rcx, %rsi\n"
+    "1:  decq %rsi\n"
+    "    movb (%rdi,%rsi), %al\n"
+    "    movb %al, (%r11,%rsi)\n"
+    "    testq %rsi, %rsi\n"
+    "    jnz 1b\n"
+    "2:  movb $0, (%rdi,%rsi)\n"
+    "    incq %rsi\n"
+    "    cmpq %r10, %rsi\n"
+    "    jb 2b\n"
+    "    addq %r10, %rcx\n"
+    // Au moins un chiffre avant la virgule
+    ".Lpd_print:\n"
+    "    cmpq $7, %rcx\n"
+    "    jae 1f\n"
+    "    movb $0, (%rdi,%rcx)\n"
+    "    incq %rcx\n"
+    "    jmp .Lpd_print\n"
+    "1:  movq %rdi, %rbx\n"
+    "    movq %rcx, %r12\n"
+    "2:  decq %r12\n"
+    "    movzbl (%rbx,%r12), %edi\n"
+    "    addl $48, %edi\n"
+    "    call __algo_putc\n"
+    "    cmpq $6, %r12\n"
+    "    ja 2b\n"
+    "    movl $46, %edi\n"
+    "    call __algo_putc\n"
+    "3:  decq %r12\n"
+    "    movzbl (%rbx,%r12), %edi\n"
+    "    addl $48, %edi\n"
+    "    call __algo_putc\n"
+    "    testq %r12, %r12\n"
+    "    jnz 3b\n"
+    "    movl $10, %edi\n"
+    "    call __algo_putc\n"
+    ".Lpd_done:\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    ret\n"
+    "\n"
+    "# Octet suivant de l'entree dans eax sans le consommer, -1 en fin\n"
+    "__algo_peekc:\n"
+    "    movq __algo_inpos(%rip), %rax\n"
+    "    cmpq __algo_inlen(%rip), %rax\n"
+    "    jb 3f\n"
+    "    call __algo_flush\n"
+    "1:  xorl %eax, %eax\n"
+    "    xorl %edi, %edi\n"
+    "    leaq __algo_inbuf(%rip), %rsi\n"
+    "    movl $65536, %edx\n"
+    "    syscall\n"
+    "    cmpq $-4, %rax\n"
+    "    je 1b\n"
+    "    testq %rax, %rax\n"
+    "    jg 2f\n"
+    "    movl $-1, %eax\n"
+    "    ret\n"
+    "2:  movq %rax, __algo_inlen(%rip)\n"
+    "    xorl %eax, %eax\n"
+    "    movq %rax, __algo_inpos(%rip)\n"
+    "3:  leaq __algo_inbuf(%rip), %rcx\n"
+    "    movzbl (%rcx,%rax), %eax\n"
+    "    ret\n"
+    "\n"
+    "# Saute les blancs; premier octet suivant dans eax\n"
+    "__algo_skipws:\n"
+    "1:  call __algo_peekc\n"
+    "    cmpl $32, %eax\n"
+    "    je 2f\n"
+    "    cmpl $9, %eax\n"
+    "    jb 3f\n"
+    "    cmpl $13, %eax\n"
+    "    ja 3f\n"
+    "2:  incq __algo_inpos(%rip)\n"
+    "    jmp 1b\n"
+    "3:  ret\n"
+    "\n"
+    "# scanf(\"%d\"): valeur dans eax, edx = 1 si un entier a ete lu\n"
+    "__algo_read_int:\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    call __algo_skipws\n"
+    "    xorl %r12d, %r12d\n"
+    "    cmpl $45, %eax\n"
+    "    jne 1f\n"
+    "    movl $1, %r12d\n"
+    "    jmp 2f\n"
+    "1:  cmpl $43, %eax\n"
+    "    jne 3f\n"
+    "2:  incq __algo_inpos(%rip)\n"
+    "3:  xorl %ebx, %ebx\n"
+    "    xorl %r13d, %r13d\n"
+    "4:  call __algo_peekc\n"
+    "    subl $48, %eax\n"
+    "    cmpl $9, %eax\n"
+    "    ja 5f\n"
+    "    incq __algo_inpos(%rip)\n"
+    "    imull $10, %ebx, %ebx\n"
+    "    addl %eax, %ebx\n"
+    "    incl %r13d\n"
+    "    jmp 4b\n"
+    "5:  xorl %edx, %edx\n"
+    "    testl %r13d, %r13d\n"
+    "    jz 6f\n"
+    "    movl %ebx, %eax\n"
+    "    testl %r12d, %r12d\n"
+    "    jz 7f\n"
+    "    negl %eax\n"
+    "7:  movl $1, %edx\n"
+    "6:  popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    ret\n"
+    "\n"
+    "# scanf(\" %c\"): octet etendu en signe dans eax, edx = 1 si lu\n"
+    "__algo_read_char:\n"
+    "    call __algo_skipws\n"
+    "    xorl %edx, %edx\n"
+    "    cmpl $-1, %eax\n"
+    "    je 1f\n"
+    "    incq __algo_inpos(%rip)\n"
+    "    movsbl %al, %eax\n"
+    "    movl $1, %edx\n"
+    "1:  ret\n"
+    "\n"
+    "# scanf(\"%f\"): valeur arrondie en float dans xmm0 (en double), edx = 1 si lue.\n"
+    "# 18 chiffres significatifs au plus dans r12, exposant decimal dans r14d;\n"
+    "# exact jusqu'a 15 chiffres et 10^22, comme la plupart des saisies.\n"
+    "__algo_read_float:\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    call __algo_skipws\n"
+    "    xorl %r15d, %r15d\n"           // r15d: negatif
+    "    cmpl $45, %eax\n"
+    "    jne 1f\n"
+    "    movl $1, %r15d\n"
+    "    jmp 2f\n"
+    "1:  cmpl $43, %eax\n"
+    "    jne 3f\n"
+    "2:  incq __algo_inpos(%rip)\n"
+    "3:  xorl %r12d, %r12d\n"
+    "    xorl %r13d, %r13d\n"           // r13d: chiffres gardes
+    "    xorl %r14d, %r14d\n"
+    "    xorl %ebx, %ebx\n"             // bit 0: chiffre lu, bit 1: point lu
+    ".Lrf_mant:\n"
+    "    call __algo_peekc\n"
+    "    cmpl $46, %eax\n"
+    "    jne 1f\n"
+    "    testl $2, %ebx\n"
+    "    jnz .Lrf_exp\n"
+    "    orl $2, %ebx\n"
+    "    incq __algo_inpos(%rip)\n"
+    "    jmp .Lrf_mant\n"
+    "1:  subl $48, %eax\n"
+    "    cmpl $9, %eax\n"
+    "    ja .Lrf_exp\n"
+    "    incq __algo_inpos(%rip)\n"
+    "    orl $1, %ebx\n"
+    "    testq %r12, %r12\n"
+    "    jnz 2f\n"
+    "    testl %eax, %eax\n"
+    "    jz 3f\n"                       // zero de tete
+    "2:  cmpl $18, %r13d\n"
+    "    jae 4f\n"
+    "    imulq $10, %r12, %r12\n"
+    "    addq %rax, %r12\n"
+    "    incl %r13d\n"
+    "3:  testl $2, %ebx\n"
+    "    jz .Lrf_mant\n"
+    "    decl %r14d\n"
+    "    jmp .Lrf_mant\n"
+    "4:  testl $2, %ebx\n"             // chiffre au-dela du 18e
+    "    jnz .Lrf_mant\n"
+    "    incl %r14d\n"
+    "    jmp .Lrf_mant\n"
+    ".Lrf_exp:\n"
+    "    testl $1, %ebx\n"
+    "    jz .Lrf_fail\n"
+    "    call __algo_peekc\n"
+    "    orl $32, %eax\n"
+    "    cmpl $101, %eax\n"
+    "    jne .Lrf_value\n"
+    "    incq __algo_inpos(%rip)\n"
+    "    call __algo_peekc\n"
+    "    xorl %r13d, %r13d\n"
+    "    cmpl $45, %eax\n"
+    "    jne 1f\n"
+    "    movl $1, %r13d\n"
+    "    jmp 2f\n"
+    "1:  cmpl $43, %eax\n"
+    "    jne 3f\n"
+    "2:  incq __algo_inpos(%rip)\n"
+    "3:  xorl %ebx, %ebx\n"
+    "4:  call __algo_peekc\n"
+    "    subl $48, %eax\n"
+    "    cmpl $9, %eax\n"
+    "    ja 5f\n"
+    "    incq __algo_inpos(%rip)\n"
+    "    cmpl $100000, %ebx\n"
+    "    jae 4b\n"
+    "    imull $10, %ebx, %ebx\n"
+    "    addl %eax, %ebx\n"
+    "    jmp 4b\n"
+    "5:  testl %r13d, %r13d\n"
+    "    jz 6f\n"
+    "    negl %ebx\n"
+    "6:  addl %ebx, %r14d\n"
+    ".Lrf_value:\n"
+    "    cvtsi2sdq %r12, %xmm0\n"
+    "    leaq __algo_pow10(%rip), %rsi\n"
+    "    movl %r14d, %ecx\n"
+    "    testl %ecx, %ecx\n"
+    "    js 3f\n"
+    "1:  cmpl $22, %ecx\n"
+    "    jle 2f\n"
+    "    mulsd 176(%rsi), %xmm0\n"
+    "    subl $22, %ecx\n"
+    "    jmp 1b\n"
+    "2:  mulsd (%rsi,%rcx,8), %xmm0\n"
+    "    jmp 5f\n"
+    "3:  negl %ecx\n"
+    "4:  cmpl $22, %ecx\n"
+    "    jle 6f\n"
+    "    divsd 176(%rsi), %xmm0\n"
+    "    subl $22, %ecx\n"
+    "    jmp 4b\n"
+    "6:  divsd (%rsi,%rcx,8), %xmm0\n"
+    "5:  cvtsd2ss %xmm0, %xmm0\n"
+    "    cvtss2sd %xmm0, %xmm0\n"
+    "    testl %r15d, %r15d\n"
+    "    jz 7f\n"
+    "    movq %xmm0, %rax\n"
+    "    btcq $63, %rax\n"
+    "    movq %rax, %xmm0\n"
+    "7:  movl $1, %edx\n"
+    "    jmp 8f\n"
+    ".Lrf_fail:\n"
+    "    xorl %edx, %edx\n"
+    "8:  popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    ret\n"
+    "\n"
+    "    .section .rodata\n"
+    "    .p2align 3\n"
+    "__algo_pow10:\n"
+    "    .double 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11\n"
+    "    .double 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22\n"
+    "__algo_inf:\n"
+    "    .byte 105, 110, 102, 10\n"
+    "__algo_nan:\n"
+    "    .byte 110, 97, 110, 10\n"
+    "\n"
+    "    .bss\n"
+    "    .p2align 4\n"
+    "__algo_outbuf:\n"
+    "    .zero 65536\n"
+    "__algo_inbuf:\n"
+    "    .zero 65536\n"
+    "__algo_outlen:\n"
+    "    .zero 8\n"
+    "__algo_inpos:\n"
+    "    .zero 8\n"
+    "__algo_inlen:\n"
+    "    .zero 8\n"
+    "__algo_digits:\n"
+    "    .zero 1100\n"
+    "\n"
+    "    .section .note.GNU-stack,\"\",@progbits\n";
+
+void asmProgramme(Node *prog){
+    AsmState st;
+    memset(&st,0,sizeof(st));
+    cc->asmState = &st;
+
+    outStr("# Genere par le compilateur de pseudo-code (--asm)\n    .text\n");
+    for(Node *f=prog->a;f;f=f->next)
+        asmFunction(f->sym->name,f->a,f->b,f->c);
+    asmFunction(NULL,NULL,prog->b,prog->c);
+
+    outStr("\n    .section .rodata\n    .p2align 3\n");
+    for(int k=0;k<st.nreals;k++){
+        uint64_t bits;
+        memcpy(&bits,&st.reals[k],8);
+        outStr(".LR");
+        outInt(k);
+        outStr(":\n    .quad ");
+        outInt((long)bits);
+        outChar('\n');
+    }
+    for(int k=0;k<st.nstrs;k++){
+        outStr(".LS");
+        outInt(k);
+        outStr(":\n    .byte ");
+        for(const char *p=st.strs[k];*p;p++){
+            if(p!=st.strs[k]) outChar(',');
+            outInt((unsigned char)*p);
+        }
+        outChar('\n');
+    }
+    outStr(asmRuntime);
+
+    free(st.reals);
+    free(st.strs);
+    cc->asmState = NULL;
+}
+
+// Micro-benchmark du lexer: tokens/s avec l'ancienne et la nouvelle classification des mots-cles
+void benchLexer(int reps){
+    for(int i=0;i<NB_KEYWORDS;i++){
+        if(keywordType(keywords[i].text,(int)strlen(keywords[i].text))!=keywords[i].type){
+            fprintf(stderr,"Table des mots-cles incoherente pour %s\n",keywords[i].text);
+            exit(1);
+        }
+    }
+
+    const char *noms[2] = {"strcmp lineaire", "longueur+initiale"};
+    for(int mode=0;mode<2;mode++){
+        lexLinear = (mode==0);
+        long tokens = 0;
+        double t0 = nowSeconds();
+        for(int r=0;r<reps;r++){
+            Token t;
+            cc->srcPos=0; cc->line=1; cc->col=0;
+            do { t=nextToken(); tokens++; } while(t.type!=TOK_EOF);
+        }
+        double dt = nowSeconds()-t0;
+        printf("%-18s %ld tokens en %.3f s: %.0f tokens/s\n", noms[mode], tokens, dt, tokens/dt);
+    }
+    lexLinear = 0;
+}
+
+/* ---------- Cache de compilation ---------- */
+
+/* Cache disque (--cache DIR): le C genere est conserve sous une cle calculee
+   a partir des octets de la source, de la version du compilateur et des
+   options qui changent le code produit. Une source deja vue est recopiee
+   sans etre analysee. Les entrees sont datees a chaque utilisation et les
+   plus anciennes sont supprimees quand le cache depasse --cache-max. */
+
+/* Version du C produit: a incrementer a la main quand une modification
+   change le code genere, les entrees du cache et les index .inc existants
+   sont alors ignores. Le build peut la fixer (-DVERSION_COMPILATEUR=...). */
+#ifndef VERSION_COMPILATEUR
+#define VERSION_COMPILATEUR "algoc 5"
+#endif
+
+const char *cacheDir = NULL;        // --cache
+long long cacheMax = 256LL<<20;     // --cache-max, en octets
+int cacheStats = 0;                 // --cache-stats
+long cacheHits = 0, cacheMisses = 0, cacheEvictions = 0;
+
+static inline uint64_t rotl64(uint64_t x, int r){
+    return (x<<r) | (x>>(64-r));
+}
+
+static inline uint64_t read64(const unsigned char *p){
+    uint64_t v;
+    memcpy(&v,p,8);
+    return v;
+}
+
+// Hachage 64 bits a quatre voies de 8 octets (schema de xxHash64)
+uint64_t hashSource(const void *data, size_t n, uint64_t seed){
+    const uint64_t P1 = 0x9E3779B185EBCA87ULL, P2 = 0xC2B2AE3D27D4EB4FULL;
+    const unsigned char *p = data;
+    uint64_t h;
+
+    if(n>=32){
+        uint64_t v[4] = { seed+P1+P2, seed+P2, seed, seed-P1 };
+        do {
+            for(int k=0;k<4;k++)
+                v[k] = rotl64(v[k]+read64(p+8*k)*P2,31)*P1;
+            p += 32;
+            n -= 32;
+        } while(n>=32);
+        h = rotl64(v[0],1) + rotl64(v[1],7) + rotl64(v[2],12) + rotl64(v[3],18);
+        for(int k=0;k<4;k++)
+            h = (h ^ rotl64(v[k]*P2,31)*P1)*P1 + P2;
+    }
+    else h = seed + P1;
+
+    h += n;
+    for(;n>=8;p+=8,n-=8)
+        h = rotl64(h ^ rotl64(read64(p)*P2,31)*P1,27)*P1 + P2;
+    for(;n>0;p++,n--)
+        h = rotl64(h ^ (*p*P1),11)*P2;
+
+    h ^= h>>33; h *= P2;
+    h ^= h>>29; h *= P1;
+    h ^= h>>32;
+    return h;
+}
+
+// Chemin de l'entree: hachage et longueur de la source
+uint64_t optionsHash();
+
+void cacheEntryPath(char *path, size_t cap, const char *src, size_t len){
+    uint64_t key = hashSource(src,len,optionsHash());
+    snprintf(path,cap,"%s/%016llx-%zx.c",cacheDir,(unsigned long long)key,len);
+}
+
+int copyFile(const char *from, const char *to){
+    int in = open(from,O_RDONLY);
+    if(in<0) return -1;
+    int out = open(to,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(out<0){ close(in); return -1; }
+
+    char *buf = malloc(1<<18);
+    ssize_t n = buf ? 0 : -1;
+    while(buf && (n = read(in,buf,1<<18)) > 0){
+        for(ssize_t off=0,w;off<n;off+=w){
+            w = write(out,buf+off,n-off);
+            if(w<=0){ n = -1; break; }
+        }
+        if(n<0) break;
+    }
+    free(buf);
+    close(in);
+    if(close(out)!=0) n = -1;
+    return n<0 ? -1 : 0;
+}
+
+// Succes: l'entree est recopiee vers output et marquee comme recente
+int cacheFetch(const char *entry, const char *output){
+    if(access(entry,R_OK)!=0 || copyFile(entry,output)!=0){
+        __atomic_fetch_add(&cacheMisses,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+    utimensat(AT_FDCWD,entry,NULL,0);
+    __atomic_fetch_add(&cacheHits,1,__ATOMIC_RELAXED);
+    return 1;
+}
+
+// Ecrit dans un fichier temporaire puis renomme: un lecteur ne voit jamais d'entree partielle
+void cacheStore(const char *entry, const char *output){
+    char tmp[PATH_MAX];
+    static long serial = 0;
+    snprintf(tmp,sizeof(tmp),"%s.%d.%ld.tmp",entry,(int)getpid(),
+        __atomic_add_fetch(&serial,1,__ATOMIC_RELAXED));
+    if(copyFile(output,tmp)!=0 || rename(tmp,entry)!=0) unlink(tmp);
+}
+
+typedef struct { char *name; off_t size; time_t used; } CacheEntry;
+
+int compareCacheAge(const void *a, const void *b){
+    time_t x = ((const CacheEntry*)a)->used, y = ((const CacheEntry*)b)->used;
+    return x<y ? -1 : x>y;
+}
+
+/* Supprime les entrees les moins recemment utilisees jusqu'a repasser
+   sous la limite. Le verrou evite que deux compilateurs evincent ensemble. */
+void cacheEvict(){
+    char path[PATH_MAX];
+    snprintf(path,sizeof(path),"%s/lock",cacheDir);
+    int lock = open(path,O_RDWR|O_CREAT,0644);
+    if(lock<0) return;
+    flock(lock,LOCK_EX);
+
+    DIR *d = opendir(cacheDir);
+    CacheEntry *entries = NULL;
+    int count = 0, cap = 0, failed = 0;
+    long long total = 0;
+    struct dirent *e;
+    // Memoire insuffisante: pas d'eviction cette fois, la suivante s'en chargera
+    while(d && (e = readdir(d))){
+        size_t len = strlen(e->d_name);
+        struct stat st;
+        if(len<3 || strcmp(e->d_name+len-2,".c")!=0) continue;
+        snprintf(path,sizeof(path),"%s/%s",cacheDir,e->d_name);
+        if(stat(path,&st)!=0) continue;
+        if(count==cap){
+            CacheEntry *bigger = realloc(entries,(cap ? cap*2 : 64)*sizeof(CacheEntry));
+            if(!bigger){
+                failed = 1;
+                break;
+            }
+            entries = bigger;
+            cap = cap ? cap*2 : 64;
+        }
+        entries[count].name = strdup(e->d_name);
+        if(!entries[count].name){
+            failed = 1;
+            break;
+        }
+        entries[count].size = st.st_size;
+        entries[count].used = st.st_mtime;
+        total += st.st_size;
+        count++;
+    }
+    if(d) closedir(d);
+
+    if(!failed && total>cacheMax){
+        qsort(entries,count,sizeof(CacheEntry),compareCacheAge);
+        for(int i=0;i<count && total>cacheMax;i++){
+            snprintf(path,sizeof(path),"%s/%s",cacheDir,entries[i].name);
+            if(unlink(path)==0){
+                total -= entries[i].size;
+                __atomic_fetch_add(&cacheEvictions,1,__ATOMIC_RELAXED);
+            }
+        }
+    }
+    for(int i=0;i<count;i++) free(entries[i].name);
+    free(entries);
+
+    // Totaux cumules sur toutes les executions, dans DIR/stats
+    long hits = 0, misses = 0, evictions = 0;
+    snprintf(path,sizeof(path),"%s/stats",cacheDir);
+    FILE *f = fopen(path,"r");
+    if(f){
+        if(fscanf(f,"%ld %ld %ld",&hits,&misses,&evictions)!=3) hits = misses = evictions = 0;
+        fclose(f);
+    }
+    hits += cacheHits; misses += cacheMisses; evictions += cacheEvictions;
+    f = fopen(path,"w");
+    if(f){
+        fprintf(f,"%ld %ld %ld\n",hits,misses,evictions);
+        fclose(f);
+    }
+    if(cacheStats)
+        fprintf(stderr,"cache: %ld succes, %ld defauts, %ld evictions, %lld octets"
+            " (cumul: %ld succes, %ld defauts, %ld evictions)\n",
+            cacheHits,cacheMisses,cacheEvictions,total,hits,misses,evictions);
+
+    flock(lock,LOCK_UN);
+    close(lock);
+}
+
+/* ---------- Compilation d'un fichier ---------- */
+
+Compilation *newCompilation(FILE *diag){
+    Compilation *c = calloc(1,sizeof(Compilation));
+    if(!c){
+        fprintf(stderr,"ERREUR: memoire insuffisante\n");
+        exit(1);
+    }
+    c->line = 1;
+    c->outFd = -1;
+    c->diag = diag;
+    return c;
+}
+
+void freeCompilation(Compilation *c){
+    if(c->src && c->src!=stdin) fclose(c->src);
+    if(c->srcBuf){
+        if(c->srcMapped) munmap((void*)c->srcBuf,c->srcLen);
+        else free((void*)c->srcBuf);
+    }
+    if(c->outFd>=0) close(c->outFd);
+    free(c->outBuf);
+    if(c->prevOut) munmap((void*)c->prevOut,c->prevOutLen);
+    free(c->lexText);
+    free(c->internTab);
+    free(c->symBuckets);
+    free(c->errors);
+    if(c->bc){
+        free(c->bc->code);
+        free(c->bc->funcs);
+        free(c->bc->reals);
+        free(c->bc->strs);
+        free(c->bc);
+    }
+    arenaFree(&c->arena);
+    free(c);
+}
+
+// Ouvre la source de la compilation courante (projection ou flux)
+int openSource(const char *path){
+    if(strcmp(path,"-")==0){
+        cc->src = stdin;
+        return 0;
+    }
+    if(streamMode){
+        cc->src = fopen(path,"r");
+        return cc->src ? 0 : -1;
+    }
+    return loadSource(path);
+}
+
+typedef struct {
+    const char *input;
+    const char *output;
+    off_t size;
+    int status;         // 0 si la compilation a reussi
+    char *diagText;     // diagnostics propres au fichier (compilation par lot)
+    size_t diagLen;
+} Job;
+
+/* Source en memoire: le lexer est rejoue seul apres l'analyse syntaxique, ce qui
+   separe son temps de celui du parseur sans chronometrer chaque lexeme. */
+void timeLexer(){
+    size_t pos = cc->srcPos;
+    int line = cc->line, col = cc->col;
+    cc->srcPos = 0; cc->line = 1; cc->col = 0;
+    double t0 = nowSeconds();
+    while(nextToken().type!=TOK_EOF);
+    cc->stats.lex = nowSeconds()-t0;
+    cc->srcPos = pos; cc->line = line; cc->col = col;
+}
+
+void jsonString(FILE *f, const char *str){
+    fputc('"',f);
+    for(const unsigned char *p=(const unsigned char*)str;*p;p++){
+        if(*p=='"' || *p=='\\') fprintf(f,"\\%c",*p);
+        else if(*p<0x20) fprintf(f,"\\u%04x",*p);
+        else fputc(*p,f);
+    }
+    fputc('"',f);
+}
+
+/* --erreurs-json: une ligne par fichier compile, toutes les erreurs avec
+   leur position; "truncated" si --max-erreurs a arrete la compilation. */
+void reportErrors(const char *input){
+    fprintf(cc->diag,"{\"file\": ");
+    jsonString(cc->diag,input);
+    fprintf(cc->diag,", \"errors\": [");
+    for(int i=0;i<cc->errorCount;i++){
+        Diagnostic *d = &cc->errors[i];
+        fprintf(cc->diag,"%s{\"kind\": \"%s\", \"line\": %d, \"col\": %d, \"message\": ",
+            i ? ", " : "", d->kind, d->line, d->col);
+        jsonString(cc->diag,d->msg);
+        fprintf(cc->diag,", \"token\": ");
+        jsonString(cc->diag,d->text);
+        fputc('}',cc->diag);
+    }
+    fprintf(cc->diag,"], \"truncated\": %s}\n",
+        maxErrors>1 && cc->errorCount>=maxErrors ? "true" : "false");
+}
+
+// Une ligne JSON par fichier compile, sur le flux de diagnostics
+void reportStats(const char *input, int ok, const char *cache, double total){
+    Stats *st = &cc->stats;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF,&ru);
+
+    fprintf(cc->diag,"{\"file\": ");
+    jsonString(cc->diag,input);
+    fprintf(cc->diag,", \"ok\": %s, \"cache\": \"%s\", \"time\": {"
+        "\"lex\": %.6f, \"parse\": %.6f, \"semantic\": %.6f, \"optimise\": %.6f, "
+        "\"codegen\": %.6f, \"io\": %.6f, \"total\": %.6f}, ",
+        ok ? "true" : "false", cache,
+        st->lex, st->parse, st->sema, st->opt, st->gen, st->io, total);
+    fprintf(cc->diag,"\"counters\": {\"source_bytes\": %zu, \"tokens\": %ld, \"symbols\": %ld, "
+        "\"lookups\": %ld, \"probes\": %ld, \"max_probe\": %ld, \"bytes_out\": %lld, "
+        "\"arena_bytes\": %zu, \"peak_rss_kb\": %ld, \"regions_reused\": %ld, \"regions_compiled\": %ld}}\n",
+        cc->srcLen, st->tokens, st->symbols,
+        st->lookups, st->probes, st->maxProbe, st->bytesOut,
+        cc->arena.total, ru.ru_maxrss, st->regionsReused, st->regionsCompiled);
+}
+
+// "-" designe la sortie standard
+void openOutput(const char *path){
+    double t0 = nowSeconds();
+    if(strcmp(path,"-")==0) cc->outFd = dup(STDOUT_FILENO);
+    else cc->outFd = open(path,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(cc->outFd<0){
+        fprintf(cc->diag,"Error: cannot open '%s'\n",path);
+        compileFailed();
+    }
+    cc->outBuf = malloc(OUT_BUFFER);
+    cc->outCap = OUT_BUFFER;
+    if(!cc->outBuf) fatal("memoire insuffisante");
+    cc->stats.io += nowSeconds()-t0;
+}
+
+/* ---------- Compilation incrementale (--incremental) ---------- */
+
+/* La source est decoupee en regions FONCTION...FINFONCTION et DEBUT...FIN;
+   l'en-tete de chaque fonction est lu au passage, toutes les signatures
+   sont donc connues avant la premiere region. Chaque region est identifiee
+   par le hachage de ses octets et de l'ensemble des signatures (une
+   fonction peut appeler n'importe quelle autre). Un index a cote de la
+   sortie (<sortie>.inc) associe chaque cle a l'emplacement de son C dans la
+   sortie precedente: une region inchangee est recopiee telle quelle, seules
+   les autres sont analysees et generees. */
+
+typedef struct {
+    size_t start, end;
+    int line, col;
+    int isMain;
+    int forward;                    // appelle une fonction definie plus loin
+    int runtimes;                   // runtimes utilises par la region
+    uint64_t key, offset, len;      // cle, C produit dans la nouvelle sortie
+    Token at;                       // nom de la fonction
+    int paramCount;
+    VarType *paramTypes;
+} Region;
+
+#define INC_MAIN 1
+#define INC_FORWARD 2
+#define INC_RUNTIME_SHIFT 2     // runtimes de la region au-dessus de ces bits
+
+typedef struct {
+    uint64_t key, offset, len;
+    unsigned flags;     // INC_MAIN, INC_FORWARD, runtimes
+} IncEntry;
+
+typedef struct {
+    IncEntry *entries;
+    unsigned mask;      // table de hachage ouverte, taille puissance de 2
+} IncIndex;
 
-        int arrSize = 0;
-        if(isTable || current.type==TOK_CO){
-            if(current.type==TOK_CO){
-                eat(TOK_CO);
-                if(current.type!=TOK_NUM)
-                    syn_error(current,"Taille de tableau doit etre une constante");
-                arrSize = atoi(current.text);
-                eat(TOK_NUM);
-                eat(TOK_CF);
-            }
-            else if(isTable){
-                syn_error(current,"Crochets attendus pour declaration de tableau");
-            }
+#define INC_MAGIC "ALGOINC3"
+
+int incrementalMode = 0;   // --incremental
+
+uint64_t optionsHash(){
+    char flags[128];
+    int n = snprintf(flags,sizeof(flags),"%s -O%d%s%s%s --inline-seuil %d",VERSION_COMPILATEUR,optLevel,
+        simdMode ? " --simd" : "",parallelMode ? " --parallel" : "",asmMode ? " --asm" : "",inlineThreshold);
+    return hashSource(flags,n,0);
+}
+
+static inline size_t outOffset(){
+    return cc->stats.bytesOut + cc->outLen;
+}
+
+// En-tete ID ( [type ID {, type ID}] ); renvoie 0 s'il est mal forme
+int scanSignature(Region *g){
+    VarType types[256];
+    int n = 0;
+    g->at = nextToken();
+    if(g->at.type!=TOK_ID || nextToken().type!=TOK_PO) return 0;
+    Token t = nextToken();
+    while(isTypeToken(t.type) && n<256){
+        types[n++] = t.type==TOK_INT ? TYPE_INT : t.type==TOK_CHAR ? TYPE_CHAR : TYPE_FLOAT;
+        if(nextToken().type!=TOK_ID) return 0;
+        t = nextToken();
+        if(t.type!=TOK_VIRGULE) break;
+        t = nextToken();
+        if(!isTypeToken(t.type)) return 0;
+    }
+    if(t.type!=TOK_PF) return 0;
+    g->paramCount = n;
+    g->paramTypes = arenaAlloc(&cc->arena,(n ? n : 1)*sizeof(VarType));
+    memcpy(g->paramTypes,types,n*sizeof(VarType));
+    return 1;
+}
+
+int scanLoop(Region **out, int *count){
+    int cap = 64, n = 0;
+    Region *r = arenaAlloc(&cc->arena,cap*sizeof(Region));
+    cc->srcPos = 0; cc->line = 1; cc->col = 0;
+
+    for(;;){
+        Region g;
+        memset(&g,0,sizeof(g));
+        g.start = cc->srcPos; g.line = cc->line; g.col = cc->col;
+        Token t = nextToken();
+        if(t.type==TOK_EOF) break;
+        if(t.type==TOK_DEBUT){
+            g.isMain = 1;
+            g.end = cc->srcLen;
+        } else if(t.type==TOK_FONCTION){
+            if(!scanSignature(&g)) return 0;
+            do t = nextToken();
+            while(t.type!=TOK_FINFONCTION && t.type!=TOK_FONCTION &&
+                  t.type!=TOK_DEBUT && t.type!=TOK_EOF);
+            if(t.type!=TOK_FINFONCTION) return 0;
+            g.end = cc->srcPos;
         }
+        else return 0;
 
-        addSymbolTyped(name,SYM_VAR,0,vtype,arrSize);
-        printIndent();
-        fprintf(out,"%s %s", typeToCStr(vtype), name);
-        if(arrSize>0) fprintf(out,"[%d]",arrSize);
-        fprintf(out,";\n");
+        if(n==cap){
+            Region *bigger = arenaAlloc(&cc->arena,2*cap*sizeof(Region));
+            memcpy(bigger,r,cap*sizeof(Region));
+            r = bigger;
+            cap *= 2;
+        }
+        r[n++] = g;
+        if(g.isMain) break;
     }
+    *out = r;
+    *count = n;
+    return n>0 && r[n-1].isMain;
+}
 
-    while(current.type!=TOK_FINFONCTION)
-        INSTRUCTION();
+/* Decoupage par le lexer seul. Source mal formee (erreur lexicale, region
+   non fermee, en-tete de fonction incorrect): renvoie 0, la compilation complete produira le diagnostic. */
+int scanRegions(Region **out, int *count){
+    jmp_buf saved;
+    FILE *diag = cc->diag, *devnull = fopen("/dev/null","w");
+    int errors = cc->errorCount;
+    memcpy(saved,cc->failure,sizeof(jmp_buf));
+    if(devnull) cc->diag = devnull;
 
-    eat(TOK_FINFONCTION);
+    int ok = setjmp(cc->failure)==0 && scanLoop(out,count);
+
+    memcpy(cc->failure,saved,sizeof(jmp_buf));
+    cc->errorCount = errors;
+    cc->diag = diag;
+    if(devnull) fclose(devnull);
+    cc->srcPos = 0; cc->line = 1; cc->col = 0;
+    return ok;
+}
 
-    indent--;
-    fprintf(out,"}\n\n");
+/* Mode pipeline: chaque FONCTION est analysee, optimisee et ecrite des son
+   FINFONCTION, le consommateur (gcc, un pipe) lit sans attendre la fin.
+   Source en memoire: les signatures sont d'abord relevees par le lexer, un
+   appel peut viser une fonction definie plus loin et les prototypes sont
+   ecrits avant la premiere fonction qui en a besoin. Source en flux: les
+   appels ne peuvent viser qu'une fonction deja definie. */
+void pipelineFonctions(){
+    Region *regions = NULL;
+    int nregions = 0, prototypes = 0;
+    // Source mal formee: declarees au fil de la lecture, l'analyse produira le diagnostic
+    int declared = !streamMode && scanRegions(&regions,&nregions);
+    if(declared){
+        for(int i=0;i<nregions;i++)
+            if(!regions[i].isMain)
+                addFunctionSymbol(regions[i].at,regions[i].paramCount,regions[i].paramTypes)->slot = i;
+    }
+    if(!streamMode) cc->current = advance();   // le decoupage a ramene le lexer au debut
+    cc->streamDecl = streamMode;
 
-    inFunction=0;
-    currentScope=0;
+    // Runtimes ecrits au fil de l'eau, avant la premiere fonction qui s'en sert
+    genEntete(0);
+    for(int index=0;cc->current.type==TOK_FONCTION;index++){
+        double t0 = nowSeconds();
+        Node *f = FONCTION_DECL();
+        double t1 = nowSeconds();
+        if(declared) f->sym = findSymbol(f->tok.text,SYM_FUNC);
+        else declareFonction(f,index);
+        analyseFonction(f);
+        prepareInline(f);
+        double t2 = nowSeconds();
+        cc->stats.parse += t1-t0;
+        cc->stats.sema += t2-t1;
+        if(cc->errorCount) continue;   // erreurs reprises: plus rien n'est ecrit
+        if(cc->forwardCalls && !prototypes){
+            for(int i=0;i<nregions;i++)
+                if(!regions[i].isMain)
+                    genPrototype(regions[i].at.text,regions[i].paramCount,regions[i].paramTypes);
+            outChar('\n');
+            prototypes = 1;
+        }
+        optimiseFonction(f);
+        double t3 = nowSeconds(), io = cc->stats.io;
+        genRuntimes(runtimeNeeds(f->c) & ~cc->runtimes);
+        genFonction(f);
+        outFlush();
+        cc->stats.opt += t3-t2;
+        cc->stats.gen += nowSeconds()-t3-(cc->stats.io-io);
+    }
 }
 
-void PROGRAM(){
-    fprintf(out,"#include <stdio.h>\n\n");
+static inline uint64_t readU64(const unsigned char *p){ uint64_t v; memcpy(&v,p,8); return v; }
+static inline uint32_t readU32(const unsigned char *p){ uint32_t v; memcpy(&v,p,4); return v; }
 
-    while(current.type==TOK_FONCTION)
-        FONCTION_DECL();
+void outputIndexPath(char *path, size_t cap, const char *output){
+    snprintf(path,cap,"%s.inc",output);
+}
 
-    fprintf(out,"int main(){\n");
-    indent++;
+/* Charge l'index et projette la sortie precedente. Index absent, d'une autre
+   version, ou sortie modifiee depuis: index vide, tout sera regenere. */
+void loadIndex(const char *output, IncIndex *idx){
+    char path[PATH_MAX];
+    idx->entries = NULL;
+    idx->mask = 0;
 
-    eat(TOK_DEBUT);
+    outputIndexPath(path,sizeof(path),output);
+    int fd = open(path,O_RDONLY);
+    struct stat st, outSt;
+    if(fd<0) return;
+    if(fstat(fd,&st)!=0 || st.st_size<44 || stat(output,&outSt)!=0 || outSt.st_size==0){
+        close(fd);
+        return;
+    }
+    unsigned char *buf = arenaAlloc(&cc->arena,st.st_size);
+    ssize_t got = read(fd,buf,st.st_size);
+    close(fd);
+    if(got!=st.st_size || memcmp(buf,INC_MAGIC,8)!=0 || readU64(buf+8)!=optionsHash() ||
+       readU64(buf+16)!=(uint64_t)outSt.st_size ||
+       readU64(buf+24)!=(uint64_t)outSt.st_mtim.tv_sec || readU64(buf+32)!=(uint64_t)outSt.st_mtim.tv_nsec)
+        return;
+
+    int outFd = open(output,O_RDONLY);
+    if(outFd<0) return;
+    void *prev = mmap(NULL,outSt.st_size,PROT_READ,MAP_PRIVATE,outFd,0);
+    close(outFd);
+    if(prev==MAP_FAILED) return;
+    cc->prevOut = prev;
+    cc->prevOutLen = outSt.st_size;
+
+    unsigned count = readU32(buf+40), size = 16;
+    while(size<2*count) size *= 2;
+    IncEntry *entries = arenaAlloc(&cc->arena,size*sizeof(IncEntry));
+    memset(entries,0,size*sizeof(IncEntry));
+
+    const unsigned char *p = buf+44, *end = buf+st.st_size;
+    for(unsigned i=0;i<count;i++,p+=28){
+        if(end-p < 28) return;
+        IncEntry e;
+        e.key = readU64(p); e.offset = readU64(p+8); e.len = readU64(p+16);
+        e.flags = readU32(p+24);
+        if(e.offset>cc->prevOutLen || e.len>cc->prevOutLen-e.offset) return;
+
+        unsigned h = (unsigned)e.key & (size-1);
+        while(entries[h].key && entries[h].key!=e.key) h = (h+1)&(size-1);
+        entries[h] = e;
+    }
+    idx->entries = entries;
+    idx->mask = size-1;
+}
+
+IncEntry *findEntry(IncIndex *idx, uint64_t key, int isMain){
+    if(!idx->entries) return NULL;
+    for(unsigned h=(unsigned)key&idx->mask;idx->entries[h].key;h=(h+1)&idx->mask){
+        if(idx->entries[h].key==key)
+            return (idx->entries[h].flags&INC_MAIN)==(unsigned)isMain ? &idx->entries[h] : NULL;
+    }
+    return NULL;
+}
+
+void writeU64(FILE *f, uint64_t v){ fwrite(&v,8,1,f); }
+void writeU32(FILE *f, uint32_t v){ fwrite(&v,4,1,f); }
+
+// Ecrit l'index de la sortie qui vient d'etre produite (fichier temporaire puis rename)
+void writeIndex(const char *output, Region *regions, int n){
+    char path[PATH_MAX], tmp[PATH_MAX+8];
+    struct stat st;
+    if(stat(output,&st)!=0) return;
+    outputIndexPath(path,sizeof(path),output);
+    snprintf(tmp,sizeof(tmp),"%s.tmp",path);
+
+    FILE *f = fopen(tmp,"wb");
+    if(!f) return;
+    fwrite(INC_MAGIC,1,8,f);
+    writeU64(f,optionsHash());
+    writeU64(f,st.st_size);
+    writeU64(f,st.st_mtim.tv_sec);
+    writeU64(f,st.st_mtim.tv_nsec);
+    writeU32(f,n);
+    for(int i=0;i<n;i++){
+        Region *g = &regions[i];
+        writeU64(f,g->key);
+        writeU64(f,g->offset);
+        writeU64(f,g->len);
+        writeU32(f,(g->isMain ? INC_MAIN : 0) | (g->forward ? INC_FORWARD : 0) |
+                   (unsigned)g->runtimes<<INC_RUNTIME_SHIFT);
+    }
+    if(fclose(f)!=0 || rename(tmp,path)!=0) unlink(tmp);
+}
+
+uint64_t signatureHash(const char *name, int paramCount, VarType *types, uint64_t h){
+    h = hashSource(name,strlen(name),h^(uint64_t)paramCount);
+    for(int k=0;k<paramCount;k++) h = hashSource(&types[k],sizeof(VarType),h);
+    return h;
+}
+
+/* Analyse sans diagnostic ni abandon (comme scanRegions). Une fonction
+   fautive n'est pas recopiee aux appels: son propre ouvrier (ou sa region
+   avec --incremental) refait l'analyse et signale l'erreur a son rang dans
+   la source. */
+int analyseSilently(Node *f){
+    jmp_buf saved;
+    FILE *diag = cc->diag, *devnull = fopen("/dev/null","w");
+    int errors = cc->errorCount, errorLine = cc->errorLine;
+    jmp_buf *recover = cc->recover;
+    memcpy(saved,cc->failure,sizeof(jmp_buf));
+    if(devnull) cc->diag = devnull;
+    cc->recover = NULL;     // pas de reprise: la premiere erreur suffit a renoncer
+
+    int ok = setjmp(cc->failure)==0;
+    if(ok) analyseFonction(f);
+    else {
+        while(cc->currentScope>0) popScope();
+        cc->inFunction = 0;
+    }
+
+    memcpy(cc->failure,saved,sizeof(jmp_buf));
+    cc->recover = recover;
+    cc->errorCount = errors;
+    cc->errorLine = errorLine;
+    cc->diag = diag;
+    if(devnull) fclose(devnull);
+    return ok;
+}
+
+// Lecture d'une region FONCTION, de meme sans diagnostic; NULL si elle est fautive
+Node *parseSilently(Region *g){
+    jmp_buf saved;
+    FILE *diag = cc->diag, *devnull = fopen("/dev/null","w");
+    int errors = cc->errorCount, errorLine = cc->errorLine;
+    jmp_buf *recover = cc->recover;
+    memcpy(saved,cc->failure,sizeof(jmp_buf));
+    if(devnull) cc->diag = devnull;
+    cc->recover = NULL;
+
+    Node *volatile f = NULL;
+    if(setjmp(cc->failure)==0){
+        cc->srcPos = g->start; cc->line = g->line; cc->col = g->col;
+        cc->current = advance();
+        f = FONCTION_DECL();
+    }
+    else cc->inHeader = 0;
+
+    memcpy(cc->failure,saved,sizeof(jmp_buf));
+    cc->recover = recover;
+    cc->errorCount = errors;
+    cc->errorLine = errorLine;
+    cc->diag = diag;
+    if(devnull) fclose(devnull);
+    return f;
+}
+
+/* Ecrit la sortie dans tmp. Renvoie 0 si la source n'a pas pu etre decoupee
+   (la compilation complete prend le relais), 1 sinon. */
+int compileIncremental(Job *job, const char *tmp){
+    Region *regions;
+    int nregions;
+    if(!scanRegions(&regions,&nregions)) return 0;
+
+    IncIndex idx;
+    loadIndex(job->output,&idx);
+
+    // Toutes les fonctions sont declarees avant la premiere region
+    initSymbols();
+    uint64_t sig = optionsHash();
+    for(int i=0;i<nregions;i++){
+        Region *g = &regions[i];
+        if(g->isMain) continue;
+        addFunctionSymbol(g->at,g->paramCount,g->paramTypes)->slot = i;
+        sig = signatureHash(g->at.text,g->paramCount,g->paramTypes,sig);
+    }
+
+    /* Fonctions a recopier aux appels: preparees avant toute region, comme
+       pour -j. Une region depend alors de leur source, qui entre dans toutes
+       les cles. */
+    for(int i=0;i<nregions;i++){
+        Region *g = &regions[i];
+        if(g->isMain) continue;
+        Node *f = parseSilently(g);
+        if(!f || !mayInline(f)) continue;
+        f->sym = findSymbol(f->tok.text,SYM_FUNC);
+        if(!analyseSilently(f)) continue;
+        prepareInline(f);
+        if(f->sym->inlineExpr) sig = hashSource(cc->srcBuf+g->start,g->end-g->start,sig);
+    }
 
-    while(current.type==TOK_INT||current.type==TOK_CHAR||current.type==TOK_FLOAT||current.type==TOK_TABLE){
-        VarType vtype;
-        int isTable = 0;
+    // Les corps d'abord, en memoire: les prototypes ne sont connus qu'a la fin
+    openOutput(tmp);
+    cc->outToMemory = 1;
+    int forward = 0, runtimes = 0;
+    for(int i=0;i<nregions;i++){
+        Region *g = &regions[i];
+        // DEBUT...FIN est la derniere region: son C (vidage final) depend des runtimes des fonctions
+        uint64_t seed = g->isMain ? hashSource(&runtimes,sizeof(runtimes),sig) : sig;
+        g->key = hashSource(cc->srcBuf+g->start,g->end-g->start,seed);
+        g->offset = outOffset();
 
-        if(current.type==TOK_INT){
-            eat(TOK_INT);
-            vtype=TYPE_INT;
+        IncEntry *e = findEntry(&idx,g->key,g->isMain);
+        if(e){
+            // Region inchangee: son C vient de la sortie precedente
+            outMem(cc->prevOut+e->offset,e->len);
+            g->forward = (e->flags&INC_FORWARD)!=0;
+            g->runtimes = e->flags>>INC_RUNTIME_SHIFT;
+            cc->stats.regionsReused++;
+        } else {
+            cc->srcPos = g->start; cc->line = g->line; cc->col = g->col;
+            cc->current = advance();
+            cc->forwardCalls = 0;
+            if(g->isMain){
+                Node *prog = PROGRAM();
+                analyseMain(prog);
+                if(!cc->errorCount){
+                    optimiseProgramme(prog);
+                    g->runtimes = runtimeNeeds(prog->c);
+                    cc->runtimes = runtimes | g->runtimes;
+                    genMain(prog);
+                }
+            } else {
+                Node *f = FONCTION_DECL();
+                f->sym = findSymbol(f->tok.text,SYM_FUNC);
+                analyseFonction(f);
+                if(!cc->errorCount){
+                    optimiseFonction(f);
+                    g->runtimes = runtimeNeeds(f->c);
+                    genFonction(f);
+                }
+            }
+            g->forward = cc->forwardCalls;
+            cc->stats.regionsCompiled++;
         }
-        else if(current.type==TOK_CHAR){
-            eat(TOK_CHAR);
-            vtype=TYPE_CHAR;
+        g->len = outOffset()-g->offset;
+        forward |= g->forward;
+        runtimes |= g->runtimes;
+    }
+    stopOnErrors();
+
+    size_t body = cc->outLen;
+    genEntete(runtimes);
+    if(forward){
+        for(int i=0;i<nregions;i++)
+            if(!regions[i].isMain)
+                genPrototype(regions[i].at.text,regions[i].paramCount,regions[i].paramTypes);
+        outChar('\n');
+    }
+    size_t prefix = cc->outLen-body;
+    outMoveToFront(body);
+    for(int i=0;i<nregions;i++) regions[i].offset += prefix;
+    cc->outToMemory = 0;
+
+    outFlush();
+    if(close(cc->outFd)!=0) fatal("ecriture du fichier de sortie impossible");
+    cc->outFd = -1;
+    if(rename(tmp,job->output)!=0){
+        fprintf(cc->diag,"Error: cannot open '%s'\n",job->output);
+        compileFailed();
+    }
+    writeIndex(job->output,regions,nregions);
+    return 1;
+}
+
+/* ---------- Compilation parallele des corps ---------- */
+
+/* Apres la pre-passe de declaration, un corps (FONCTION ou DEBUT...FIN) ne
+   depend plus que des signatures: analyse, optimisation et generation se
+   font en parallele. Chaque ouvrier a sa Compilation (symboles, arene,
+   tampon de sortie memoire) ou les fonctions sont recopiees en portee 0;
+   les sorties sont ensuite concatenees dans l'ordre de la source. Avec
+   --stats, analyse et optimisation sont cumulees sur les ouvriers. */
+
+int functionThreads = 1;   // -j sur un seul fichier
+
+typedef struct {
+    Node *node;         // FONCTION, ou le programme pour DEBUT...FIN
+    int status;
+    char *code, *diagText;
+    size_t codeLen, diagLen;
+} BodyTask;
+
+typedef struct {
+    Node *prog;
+    BodyTask *tasks;
+    int ntasks;
+    int next;           // prochaine tache, prise par increment atomique
+    int runtimes;       // runtimes du programme, connus avant les ouvriers
+} BodyPool;
+
+typedef struct {
+    BodyPool *pool;
+    Compilation *c;
+} BodyWorker;
+
+// Copie d'une fonction declaree par une autre compilation
+void importSymbol(Symbol *from){
+    Token at = { TOK_ID, from->name, 0, 0 };
+    Symbol *sym = addSymbolTyped(at,SYM_FUNC,from->paramCount,from->vtype,0);
+    sym->paramTypes = from->paramTypes;
+    sym->slot = from->slot;
+    sym->inlineExpr = from->inlineExpr;
+    sym->inlineParams = from->inlineParams;
+}
+
+void compileBody(Node *n, Node *prog){
+    double t0 = nowSeconds();
+    if(n==prog) analyseMain(prog);
+    else analyseFonction(n);
+    double t1 = nowSeconds();
+    if(n==prog) optimiseMain(prog);
+    else optimiseFonction(n);
+    double t2 = nowSeconds();
+    if(n==prog) genMain(prog);
+    else genFonction(n);
+    cc->stats.sema += t1-t0;
+    cc->stats.opt += t2-t1;
+    cc->stats.gen += nowSeconds()-t2;
+}
+
+void *bodyWorkerMain(void *arg){
+    BodyWorker *w = arg;
+    BodyPool *pool = w->pool;
+    Compilation *saved = cc;
+    cc = w->c;
+
+    initSymbols();
+    for(Node *f=pool->prog->a;f;f=f->next)
+        importSymbol(f->sym);
+    cc->stats.symbols = 0;   // deja comptees par la compilation principale
+    cc->runtimes = pool->runtimes;
+
+    for(;;){
+        int t = __atomic_fetch_add(&pool->next,1,__ATOMIC_RELAXED);
+        if(t>=pool->ntasks) break;
+
+        BodyTask *task = &pool->tasks[t];
+        FILE *diag = open_memstream(&task->diagText,&task->diagLen);
+        cc->diag = diag ? diag : stderr;
+        task->status = 1;
+        if(setjmp(cc->failure)==0){
+            cc->outBuf = malloc(OUT_BUFFER);
+            cc->outCap = OUT_BUFFER;
+            cc->outLen = 0;
+            cc->outToMemory = 1;
+            if(!cc->outBuf) fatal("memoire insuffisante");
+            compileBody(task->node,pool->prog);
+            task->code = cc->outBuf;
+            task->codeLen = cc->outLen;
+            cc->outBuf = NULL;
+            task->status = 0;
+        } else {
+            while(cc->currentScope>0) popScope();
+            free(cc->outBuf);
+            cc->outBuf = NULL;
         }
-        else if(current.type==TOK_FLOAT){
-            eat(TOK_FLOAT);
-            vtype=TYPE_FLOAT;
+        if(diag) fclose(diag);
+    }
+    cc->diag = stderr;
+    cc = saved;
+    return NULL;
+}
+
+/* Ecrit le programme sur la sortie ouverte. En cas d'erreur, le diagnostic
+   est celui du premier corps fautif dans l'ordre de la source. */
+void genParallel(Node *prog, int nthreads){
+    int ntasks = 1, index = 0;
+    for(Node *f=prog->a;f;f=f->next){
+        declareFonction(f,index++);
+        ntasks++;
+    }
+    if(nthreads>ntasks) nthreads = ntasks;
+
+    // Les fonctions a recopier aux appels sont analysees avant les ouvriers, qui en lisent la copie
+    for(Node *f=prog->a;f;f=f->next)
+        if(mayInline(f) && analyseSilently(f))
+            prepareInline(f);
+
+    BodyPool pool = { prog, calloc(ntasks,sizeof(BodyTask)), ntasks, 0, programmeNeeds(prog) };
+    BodyWorker *workers = calloc(nthreads,sizeof(BodyWorker));
+    pthread_t *threads = malloc(nthreads*sizeof(pthread_t));
+    if(!pool.tasks || !workers || !threads) fatal("memoire insuffisante");
+    index = 0;
+    for(Node *f=prog->a;f;f=f->next)
+        pool.tasks[index++].node = f;
+    pool.tasks[index].node = prog;
+
+    // Thread refuse: les taches restantes reviennent aux ouvriers lances, au pire au thread courant seul
+    int started = nthreads;
+    for(int w=0;w<nthreads;w++){
+        workers[w].pool = &pool;
+        workers[w].c = newCompilation(stderr);
+        if(w>0 && w<started && pthread_create(&threads[w],NULL,bodyWorkerMain,&workers[w])!=0)
+            started = w;
+    }
+    bodyWorkerMain(&workers[0]);
+    for(int w=1;w<started;w++)
+        pthread_join(threads[w],NULL);
+
+    int failed = 0;
+    for(int w=0;w<nthreads;w++){
+        Compilation *c = workers[w].c;
+        cc->stats.sema += c->stats.sema;
+        cc->stats.opt += c->stats.opt;
+        cc->stats.symbols += c->stats.symbols;
+        cc->stats.lookups += c->stats.lookups;
+        cc->stats.probes += c->stats.probes;
+        if(c->stats.maxProbe>cc->stats.maxProbe) cc->stats.maxProbe = c->stats.maxProbe;
+        cc->nbFolded += c->nbFolded;
+        cc->nbSimplified += c->nbSimplified;
+        cc->nbDeadBranches += c->nbDeadBranches;
+        cc->nbUnreachable += c->nbUnreachable;
+        cc->nbUnusedVars += c->nbUnusedVars;
+        cc->nbHoisted += c->nbHoisted;
+        cc->nbReduced += c->nbReduced;
+        cc->nbInlined += c->nbInlined;
+        cc->nbSimd += c->nbSimd;
+        cc->nbSimdCandidates += c->nbSimdCandidates;
+        cc->nbParallel += c->nbParallel;
+        cc->nbParallelCandidates += c->nbParallelCandidates;
+        cc->forwardCalls |= c->forwardCalls;
+    }
+    for(int t=0;t<ntasks;t++){
+        BodyTask *task = &pool.tasks[t];
+        if(!failed && task->diagLen) fwrite(task->diagText,1,task->diagLen,cc->diag);
+        failed |= task->status;
+    }
+
+    if(!failed){
+        genEntete(pool.runtimes);
+        genPrototypes(prog);
+        for(int t=0;t<ntasks;t++)
+            outMem(pool.tasks[t].code,pool.tasks[t].codeLen);
+    }
+
+    for(int t=0;t<ntasks;t++){
+        free(pool.tasks[t].code);
+        free(pool.tasks[t].diagText);
+    }
+    // Les arenes des ouvriers portent une partie de l'AST: liberees en dernier
+    for(int w=0;w<nthreads;w++)
+        freeCompilation(workers[w].c);
+    free(pool.tasks);
+    free(workers);
+    free(threads);
+    if(failed) compileFailed();
+    reportOptimisations();
+}
+
+// Lance un outil externe (as, ld) et attend sa fin; renvoie 0 s'il a reussi
+int runTool(char *const argv[]){
+    pid_t pid = fork();
+    if(pid<0) return -1;
+    if(pid==0){
+        execvp(argv[0],argv);
+        _exit(127);
+    }
+    int st;
+    while(waitpid(pid,&st,0)<0)
+        if(errno!=EINTR) return -1;
+    return WIFEXITED(st) && WEXITSTATUS(st)==0 ? 0 : -1;
+}
+
+/* --asm: une sortie sans l'extension .s est un executable, assemble et lie
+   a partir de fichiers intermediaires supprimes ensuite. */
+void assembleAndLink(const char *output, const char *asmPath, const char *objPath){
+    char *as[] = { "as", "-o", (char*)objPath, (char*)asmPath, NULL };
+    char *ld[] = { "ld", "-o", (char*)output, (char*)objPath, NULL };
+    const char *failed = runTool(as)!=0 ? "as" : runTool(ld)!=0 ? "ld" : NULL;
+    unlink(asmPath);
+    unlink(objPath);
+    if(failed){
+        fprintf(cc->diag,"Error: %s failed for '%s'\n",failed,output);
+        compileFailed();
+    }
+}
+
+/* Compile job->input vers job->output, ou l'execute avec --run.
+   Renvoie 0 si tout s'est bien passe (ou le code de sortie du programme). */
+int compileFile(Job *job, FILE *diag, int runMode){
+    Compilation *c = newCompilation(diag);
+    volatile int status = 1;
+    volatile int ok = 0;
+    const char *volatile cache = "off";
+    double start = nowSeconds(), t0 = start;
+    // --asm: ni cache, ni incremental, ni ecriture au fil de l'eau (propres au C)
+    int native = asmMode && !runMode;
+    int incremental = incrementalMode && !native && !runMode && !streamMode && strcmp(job->output,"-")!=0;
+    char tmp[PATH_MAX];
+    snprintf(tmp,sizeof(tmp),"%s.tmp",job->output);
+    size_t outLen = strlen(job->output);
+    int link = native && strcmp(job->output,"-")!=0 &&
+               !(outLen>2 && strcmp(job->output+outLen-2,".s")==0);
+    char asmPath[PATH_MAX], objPath[PATH_MAX];
+    snprintf(asmPath,sizeof(asmPath),"%s.s",job->output);
+    snprintf(objPath,sizeof(objPath),"%s.o",job->output);
+    cc = c;
+
+    if(setjmp(c->failure)==0){
+        if(openSource(job->input)!=0){
+            fprintf(diag,"Error: cannot open '%s'\n",job->input);
+            compileFailed();
         }
-        else{
-            eat(TOK_TABLE);
-            isTable = 1;
+        c->stats.io += nowSeconds()-t0;
 
-            if(current.type==TOK_INT){
-                eat(TOK_INT);
-                vtype=TYPE_INT;
+        // Le cache travaille sur la source en memoire et ne concerne que le C genere
+        char entry[PATH_MAX];
+        int useCache = cacheDir && !native && !streamMode && !runMode && !optReport && strcmp(job->output,"-")!=0;
+        if(useCache){
+            cacheEntryPath(entry,sizeof(entry),c->srcBuf,c->srcLen);
+            cache = "miss";
+            t0 = nowSeconds();
+            if(cacheFetch(entry,job->output)){
+                c->stats.io += nowSeconds()-t0;
+                cache = "hit";
+                ok = 1;
+                status = 0;
+                longjmp(c->failure,2);
             }
-            else if(current.type==TOK_CHAR){
-                eat(TOK_CHAR);
-                vtype=TYPE_CHAR;
-            }
-            else if(current.type==TOK_FLOAT){
-                eat(TOK_FLOAT);
-                vtype=TYPE_FLOAT;
+        }
+
+        if(incremental){
+            t0 = nowSeconds();
+            if(compileIncremental(job,tmp)){
+                c->stats.gen = nowSeconds()-t0;
+                if(useCache) cacheStore(entry,job->output);
+                ok = 1;
+                status = 0;
+                longjmp(c->failure,2);
             }
-            else syn_error(current,"Type de tableau attendu (INT, FLOAT, CHAR) apres TABLE");
         }
 
-        char name[64];
-        strcpy(name,current.text);
-        eat(TOK_ID);
+        // Sortie standard ou source en flux: chaque fonction est ecrite des qu'elle est compilee
+        int pipeline = !runMode && !native && (streamMode || strcmp(job->output,"-")==0);
+        if(pipeline) openOutput(job->output);
+
+        t0 = nowSeconds();
+        initSymbols();
+        c->current=advance();
+        if(pipeline){
+            double tp = nowSeconds();
+            pipelineFonctions();
+            t0 += nowSeconds()-tp;   // deja reparti par phase
+        }
+        Node *prog = PROGRAM();
+        c->stats.parse += nowSeconds()-t0;
+        if(statsMode && !streamMode) timeLexer();
+        c->stats.parse -= c->stats.lex;
+
+        /* Un seul fichier sur plusieurs coeurs: les corps sont compiles en
+           parallele. Pas avec la reprise sur erreur: chaque ouvrier ne verrait
+           que ses propres erreurs. */
+        int parallel = !runMode && !native && !pipeline && functionThreads>1 && prog->a &&
+                       maxErrors==1 && !errorsJson;
+        if(!parallel){
+            t0 = nowSeconds();
+            analyseProgramme(prog);
+            c->stats.sema += nowSeconds()-t0;
+            stopOnErrors();
+
+            t0 = nowSeconds();
+            optimiseProgramme(prog);
+            c->stats.opt += nowSeconds()-t0;
+        }
+
+        // --run: execution directe par la machine virtuelle, sans fichier C
+        if(runMode){
+            t0 = nowSeconds();
+            bcProgramme(prog);
+            c->stats.gen = nowSeconds()-t0;
+            ok = 1;
+            if(statsMode) reportStats(job->input,1,cache,nowSeconds()-start);
+            status = vmRun();
+        } else {
+            if(!pipeline) openOutput(link ? asmPath : job->output);
 
-        int arrSize = 0;
-        if(isTable || current.type==TOK_CO){
-            if(current.type==TOK_CO){
-                eat(TOK_CO);
-                if(current.type!=TOK_NUM)
-                    syn_error(current,"Taille de tableau doit etre une constante");
-                arrSize = atoi(current.text);
-                eat(TOK_NUM);
-                eat(TOK_CF);
+            t0 = nowSeconds();
+            double io = c->stats.io;
+            if(pipeline){
+                genRuntimes(runtimeNeeds(prog->c) & ~cc->runtimes);
+                genMain(prog);
             }
-            else if(isTable){
-                syn_error(current,"Crochets attendus pour declaration de tableau");
+            else if(native) asmProgramme(prog);
+            else if(parallel) genParallel(prog,functionThreads);
+            else genProgramme(prog);
+            outFlush();
+            c->stats.gen += nowSeconds()-t0-(c->stats.io-io);
+
+            t0 = nowSeconds();
+            if(close(c->outFd)!=0) fatal("ecriture du fichier de sortie impossible");
+            c->outFd = -1;
+            if(useCache) cacheStore(entry,job->output);
+            c->stats.io += nowSeconds()-t0;
+            if(link){
+                t0 = nowSeconds();
+                assembleAndLink(job->output,asmPath,objPath);
+                c->stats.gen += nowSeconds()-t0;
             }
+            ok = 1;
+            status = 0;
         }
+    }
 
-        addSymbolTyped(name,SYM_VAR,0,vtype,arrSize);
-        printIndent();
-        fprintf(out,"%s %s", typeToCStr(vtype), name);
-        if(arrSize>0) fprintf(out,"[%d]",arrSize);
-        fprintf(out,";\n");
+    if(incremental && !ok) unlink(tmp);
+    if(errorsJson) reportErrors(job->input);
+    if(statsMode && !(runMode && ok)) reportStats(job->input,ok,cache,nowSeconds()-start);
+    freeCompilation(c);
+    cc = NULL;
+    return status;
+}
+
+/* ---------- Compilation par lot ---------- */
+
+/* Pool de threads a vol de taches: chaque ouvrier vide sa propre file par
+   la fin, puis vole les taches des autres files par le debut. */
+typedef struct {
+    pthread_mutex_t lock;
+    int *tasks;
+    int head, tail;
+} WorkQueue;
+
+typedef struct {
+    WorkQueue *queues;
+    int nworkers;
+    Job *jobs;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int id;
+} Worker;
+
+int popTask(WorkQueue *q){
+    int t = -1;
+    pthread_mutex_lock(&q->lock);
+    if(q->head<q->tail) t = q->tasks[--q->tail];
+    pthread_mutex_unlock(&q->lock);
+    return t;
+}
+
+int stealTask(WorkQueue *q){
+    int t = -1;
+    pthread_mutex_lock(&q->lock);
+    if(q->head<q->tail) t = q->tasks[q->head++];
+    pthread_mutex_unlock(&q->lock);
+    return t;
+}
+
+void *workerMain(void *arg){
+    Worker *w = arg;
+    Pool *pool = w->pool;
+    for(;;){
+        int t = popTask(&pool->queues[w->id]);
+        for(int k=1;t<0 && k<pool->nworkers;k++)
+            t = stealTask(&pool->queues[(w->id+k)%pool->nworkers]);
+        if(t<0) break;
+
+        Job *job = &pool->jobs[t];
+        FILE *diag = open_memstream(&job->diagText,&job->diagLen);
+        job->status = compileFile(job,diag ? diag : stderr,0);
+        if(diag) fclose(diag);
     }
+    return NULL;
+}
 
-    while(current.type!=TOK_FIN)
-        INSTRUCTION();
+Job *sortJobs;
 
-    eat(TOK_FIN);
+// Du plus petit au plus gros: chaque ouvrier commence par le plus gros de sa file
+int compareJobSize(const void *a, const void *b){
+    off_t x = sortJobs[*(const int*)a].size, y = sortJobs[*(const int*)b].size;
+    return x<y ? -1 : x>y;
+}
+
+// Compile tous les fichiers; renvoie le nombre d'echecs
+int compileBatch(Job *jobs, int njobs, int nworkers){
+    if(nworkers>njobs) nworkers = njobs;
+
+    int *order = malloc(njobs*sizeof(int));
+    Pool pool = { calloc(nworkers,sizeof(WorkQueue)), nworkers, jobs };
+    pthread_t *threads = malloc(nworkers*sizeof(pthread_t));
+    Worker *workers = malloc(nworkers*sizeof(Worker));
+    int allocated = order && pool.queues && threads && workers;
+    for(int w=0;allocated && w<nworkers;w++)
+        allocated = (pool.queues[w].tasks = malloc(njobs*sizeof(int)))!=NULL;
+    // Aucune compilation en cours: pas de fatal()
+    if(!allocated){
+        fprintf(stderr,"ERREUR: memoire insuffisante\n");
+        exit(1);
+    }
+
+    for(int i=0;i<njobs;i++){
+        struct stat st;
+        jobs[i].size = stat(jobs[i].input,&st)==0 ? st.st_size : 0;
+        order[i] = i;
+    }
+    sortJobs = jobs;
+    qsort(order,njobs,sizeof(int),compareJobSize);
+
+    for(int w=0;w<nworkers;w++)
+        pthread_mutex_init(&pool.queues[w].lock,NULL);
+    // Distribution circulaire depuis les plus gros fichiers
+    for(int k=njobs-1,w=0;k>=0;k--,w=(w+1)%nworkers){
+        WorkQueue *q = &pool.queues[w];
+        memmove(q->tasks+1,q->tasks,q->tail*sizeof(int));
+        q->tasks[0] = order[k];
+        q->tail++;
+    }
+
+    // Thread refuse: sa file est volee par les autres ouvriers, au pire tout est compile ici
+    int started = nworkers;
+    for(int w=0;w<nworkers;w++){
+        workers[w].pool = &pool;
+        workers[w].id = w;
+        if(w>0 && w<started && pthread_create(&threads[w],NULL,workerMain,&workers[w])!=0)
+            started = w;
+    }
+    workerMain(&workers[0]);
+    for(int w=1;w<started;w++)
+        pthread_join(threads[w],NULL);
+
+    // Comptes rendus dans l'ordre de la ligne de commande
+    int failures = 0;
+    for(int i=0;i<njobs;i++){
+        printf("Compilation du fichier %s\n", jobs[i].input);
+        fflush(stdout);
+        if(jobs[i].diagLen) fwrite(jobs[i].diagText,1,jobs[i].diagLen,stderr);
+        free(jobs[i].diagText);
+        if(jobs[i].status==0){
+            printf("Compilation reussie\n");
+            printf("Fichier compile: %s\n", jobs[i].output);
+        }
+        else failures++;
+    }
+
+    for(int w=0;w<nworkers;w++){
+        pthread_mutex_destroy(&pool.queues[w].lock);
+        free(pool.queues[w].tasks);
+    }
+    free(pool.queues);
+    free(threads);
+    free(workers);
+    free(order);
+    return failures;
+}
+
+/* ---------- Serveur de compilation (--serveur, --client) ---------- */
+
+/* Le serveur reste resident et ecoute sur une socket Unix. Chaque connexion
+   est servie par son propre thread avec son propre contexte de compilation;
+   les options (-O0, ...) sont celles du serveur.
+   Requete: "ALGQ", longueur de la source (u64), source.
+   Reponse: "ALGR", statut (u32), longueur du C (u64), longueur des
+   diagnostics (u64), C, diagnostics. */
+
+int readFull(int fd, void *buf, size_t n){
+    for(size_t off=0;off<n;){
+        ssize_t r = read(fd,(char*)buf+off,n-off);
+        if(r<0 && errno==EINTR) continue;
+        if(r<=0) return -1;
+        off += (size_t)r;
+    }
+    return 0;
+}
+
+int writeFull(int fd, const void *buf, size_t n){
+    for(size_t off=0;off<n;){
+        ssize_t w = write(fd,(const char*)buf+off,n-off);
+        if(w<0 && errno==EINTR) continue;
+        if(w<=0) return -1;
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+int socketAddress(struct sockaddr_un *addr, const char *path){
+    memset(addr,0,sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr->sun_path)){
+        fprintf(stderr,"Error: socket path too long '%s'\n",path);
+        return -1;
+    }
+    strcpy(addr->sun_path,path);
+    return 0;
+}
+
+/* Compile une source recue en memoire (prise en charge: liberee ici).
+   Le C produit est rendu dans *out (a liberer), les diagnostics vont a diag. */
+int compileBuffer(char *src, size_t len, FILE *diag, char **out, size_t *outLen){
+    Compilation *c = newCompilation(diag);
+    volatile int status = 1;
+    cc = c;
+    c->srcBuf = src;
+    c->srcLen = len;
+    *out = NULL;
+    *outLen = 0;
+
+    if(setjmp(c->failure)==0){
+        initSymbols();
+        c->current=advance();
+        Node *prog = PROGRAM();
+        analyseProgramme(prog);
+        stopOnErrors();
+        optimiseProgramme(prog);
+
+        c->outToMemory = 1;
+        c->outCap = OUT_BUFFER;
+        c->outBuf = malloc(c->outCap);
+        if(!c->outBuf) fatal("memoire insuffisante");
+        genProgramme(prog);
+        *out = c->outBuf;
+        *outLen = c->outLen;
+        c->outBuf = NULL;
+        status = 0;
+    }
+
+    freeCompilation(c);
+    cc = NULL;
+    return status;
+}
+
+void *serveClient(void *arg){
+    int fd = (int)(intptr_t)arg;
+    char magic[4];
+    uint64_t len;
+    char *src = NULL;
+
+    if(readFull(fd,magic,4)==0 && memcmp(magic,"ALGQ",4)==0 &&
+       readFull(fd,&len,8)==0 && (src = malloc(len ? len : 1)) && readFull(fd,src,len)==0){
+        char *diagText = NULL, *code = NULL;
+        size_t diagLen = 0, codeLen = 0;
+        FILE *diag = open_memstream(&diagText,&diagLen);
+        uint32_t status = diag ? compileBuffer(src,len,diag,&code,&codeLen) : 1;
+        src = NULL;
+        if(diag) fclose(diag);
+
+        uint64_t lens[2] = { codeLen, diagLen };
+        if(writeFull(fd,"ALGR",4)==0 && writeFull(fd,&status,4)==0 && writeFull(fd,lens,16)==0 &&
+           writeFull(fd,code,codeLen)==0)
+            writeFull(fd,diagText,diagLen);
+        free(code);
+        free(diagText);
+    }
+    free(src);
+    close(fd);
+    return NULL;
+}
+
+int runServer(const char *path){
+    struct sockaddr_un addr;
+    if(socketAddress(&addr,path)!=0) return 1;
+
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    unlink(path);
+    if(fd<0 || bind(fd,(struct sockaddr*)&addr,sizeof(addr))!=0 || listen(fd,64)!=0){
+        fprintf(stderr,"Error: cannot listen on '%s'\n",path);
+        return 1;
+    }
+    signal(SIGPIPE,SIG_IGN);
+    fprintf(stderr,"Serveur de compilation en attente sur %s\n",path);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    for(;;){
+        int client = accept(fd,NULL,NULL);
+        if(client<0){
+            if(errno==EINTR || errno==ECONNABORTED) continue;
+            fprintf(stderr,"Error: accept failed\n");
+            break;
+        }
+        pthread_t t;
+        if(pthread_create(&t,&attr,serveClient,(void*)(intptr_t)client)!=0)
+            close(client);
+    }
+    pthread_attr_destroy(&attr);
+    close(fd);
+    unlink(path);
+    return 1;
+}
+
+// Client: envoie la source, ecrit le C recu dans output et les diagnostics sur stderr
+int runClient(const char *path, const char *input, const char *output){
+    struct sockaddr_un addr;
+    if(socketAddress(&addr,path)!=0) return 1;
 
-    indent--;
-    fprintf(out,"    return 0;\n}\n");
+    Compilation *c = newCompilation(stderr);
+    cc = c;
+    volatile int rc = 1;
+    if(setjmp(c->failure)!=0) goto done;
+    if(strcmp(input,"-")==0 ? loadSource("/dev/stdin")!=0 : loadSource(input)!=0){
+        fprintf(stderr,"Error: cannot open '%s'\n",input);
+        goto done;
+    }
+
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd<0 || connect(fd,(struct sockaddr*)&addr,sizeof(addr))!=0){
+        fprintf(stderr,"Error: cannot connect to '%s'\n",path);
+        if(fd>=0) close(fd);
+        goto done;
+    }
+
+    uint64_t len = c->srcLen, lens[2];
+    uint32_t status;
+    char magic[4];
+    if(writeFull(fd,"ALGQ",4)!=0 || writeFull(fd,&len,8)!=0 || writeFull(fd,c->srcBuf,len)!=0 ||
+       readFull(fd,magic,4)!=0 || memcmp(magic,"ALGR",4)!=0 ||
+       readFull(fd,&status,4)!=0 || readFull(fd,lens,16)!=0){
+        fprintf(stderr,"Error: bad reply from '%s'\n",path);
+        close(fd);
+        goto done;
+    }
+
+    char *code = malloc(lens[0] ? lens[0] : 1), *diagText = malloc(lens[1]+1);
+    if(code && diagText && readFull(fd,code,lens[0])==0 && readFull(fd,diagText,lens[1])==0){
+        fwrite(diagText,1,lens[1],stderr);
+        if(status==0){
+            c->outFd = strcmp(output,"-")==0 ? dup(STDOUT_FILENO) : open(output,O_WRONLY|O_CREAT|O_TRUNC,0644);
+            if(c->outFd<0 || writeFull(c->outFd,code,lens[0])!=0)
+                fprintf(stderr,"Error: cannot open '%s'\n",output);
+            else rc = 0;
+        }
+    }
+    else fprintf(stderr,"Error: bad reply from '%s'\n",path);
+    free(code);
+    free(diagText);
+    close(fd);
+
+done:
+    freeCompilation(c);
+    cc = NULL;
+    return rc;
+}
+
+// a.algo -> a.c (a.s avec --asm)
+char *outputNameFor(const char *input){
+    const char *slash = strrchr(input,'/');
+    const char *dot = strrchr(input,'.');
+    size_t base = (dot && (!slash || dot>slash)) ? (size_t)(dot-input) : strlen(input);
+    char *name = malloc(base+3);
+    if(!name){
+        fprintf(stderr,"ERREUR: memoire insuffisante\n");
+        exit(1);
+    }
+    memcpy(name,input,base);
+    strcpy(name+base,asmMode ? ".s" : ".c");
+    return name;
 }
 
 int main(int argc, char *argv[]) {
-    char *input_file = NULL;
-    char *output_file = "output.c";
+    char **inputs = malloc(argc*sizeof(char*));
+    if (inputs == NULL) {
+        fprintf(stderr, "ERREUR: memoire insuffisante\n");
+        return 1;
+    }
+    int ninputs = 0;
+    char *output_file = NULL;
+    int benchLex = 0;
+    int runMode = 0;
+    const char *serverPath = NULL, *clientPath = NULL;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-o") == 0) {
@@ -951,29 +6912,175 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Error: -o option requires a filename\n");
                 return 1;
             }
-        } else if (input_file == NULL) {
-            input_file = argv[i];
-        } else {
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                nthreads = atoi(argv[i + 1]);
+                i++;
+            } else {
+                fprintf(stderr, "Error: -j option requires a positive number\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            if (i + 1 < argc) {
+                cacheDir = argv[i + 1];
+                i++;
+            } else {
+                fprintf(stderr, "Error: --cache option requires a directory\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--cache-max") == 0) {
+            if (i + 1 < argc && atoll(argv[i + 1]) > 0) {
+                cacheMax = atoll(argv[i + 1]) << 20;
+                i++;
+            } else {
+                fprintf(stderr, "Error: --cache-max option requires a size in MB\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsMode = 1;
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            cacheStats = 1;
+        } else if (strcmp(argv[i], "--serveur") == 0 || strcmp(argv[i], "--client") == 0) {
+            if (i + 1 < argc) {
+                if (argv[i][2] == 's') serverPath = argv[i + 1];
+                else clientPath = argv[i + 1];
+                i++;
+            } else {
+                fprintf(stderr, "Error: %s option requires a socket path\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incrementalMode = 1;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streamMode = 1;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            optLevel = 0;
+        } else if (strcmp(argv[i], "--opt-report") == 0) {
+            optReport = 1;
+        } else if (strcmp(argv[i], "--simd") == 0) {
+            simdMode = 1;
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            parallelMode = 1;
+        } else if (strcmp(argv[i], "--inline-seuil") == 0) {
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                inlineThreshold = atoi(argv[i + 1]);
+                i++;
+            } else {
+                fprintf(stderr, "Error: --inline-seuil option requires a node count (0 disables inlining)\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-erreurs") == 0) {
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                maxErrors = atoi(argv[i + 1]);
+                i++;
+            } else {
+                fprintf(stderr, "Error: --max-erreurs option requires a positive number\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--erreurs-json") == 0) {
+            errorsJson = 1;
+        } else if (strcmp(argv[i], "--asm") == 0) {
+            asmMode = 1;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            runMode = 1;
+        } else if (strcmp(argv[i], "--bench-lex") == 0) {
+            benchLex = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
             fprintf(stderr, "Error: Unexpected argument '%s'\n", argv[i]);
             return 1;
+        } else {
+            inputs[ninputs++] = argv[i];
+        }
+    }
+
+    if (serverPath && ninputs == 0) return runServer(serverPath);
+    if (clientPath && ninputs == 1) {
+        const char *out = output_file ? output_file : "output.c";
+        int quiet = strcmp(out, "-") == 0;
+        if (!quiet) printf("Compilation du fichier %s\n", inputs[0]);
+        fflush(stdout);
+        int rc = runClient(clientPath, inputs[0], out);
+        if (rc == 0 && !quiet) {
+            printf("Compilation reussie\n");
+            printf("Fichier compile: %s\n", out);
         }
+        return rc;
     }
 
-    if (input_file == NULL) {
-        fprintf(stderr, "Usage: %s <input_file> [-o output_file]\n", argv[0]);
+    if (ninputs == 0 || serverPath || clientPath) {
+        fprintf(stderr, "Usage: %s <input_file|->... [-o output_file|-] [-j threads] [--cache dir] [--cache-max MB] [--cache-stats] [--stats] [--incremental] [-O0] [--opt-report] [--simd] [--parallel] [--inline-seuil N] [--max-erreurs N] [--erreurs-json] [--asm] [--run] [--stream] [--bench-lex]\n"
+                        "       %s --serveur <socket> [-O0]\n"
+                        "       %s --client <socket> <input_file|-> [-o output_file|-]\n",
+                        argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (cacheDir && mkdir(cacheDir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: cannot create cache directory '%s'\n", cacheDir);
         return 1;
     }
 
-    src=fopen(input_file,"r");
-    out=fopen(output_file,"w");
-    printf("Compilation du fichier %s\n", input_file);
+    if (ninputs > 1) {
+        if (output_file || runMode || benchLex) {
+            fprintf(stderr, "Error: -o, --run and --bench-lex take a single input file\n");
+            return 1;
+        }
+        for (int i = 0; i < ninputs; i++) {
+            if (strcmp(inputs[i], "-") == 0) {
+                fprintf(stderr, "Error: standard input takes a single input file\n");
+                return 1;
+            }
+        }
+        Job *jobs = calloc(ninputs, sizeof(Job));
+        if (jobs == NULL) {
+            fprintf(stderr, "ERREUR: memoire insuffisante\n");
+            return 1;
+        }
+        for (int i = 0; i < ninputs; i++) {
+            jobs[i].input = inputs[i];
+            jobs[i].output = outputNameFor(inputs[i]);
+        }
+        int failures = compileBatch(jobs, ninputs, (int)nthreads);
+        if (cacheDir) cacheEvict();
+        for (int i = 0; i < ninputs; i++) free((char*)jobs[i].output);
+        free(jobs);
+        free(inputs);
+        return failures ? 1 : 0;
+    }
+
+    Job job = { inputs[0], output_file ? output_file : asmMode ? "output.s" : "output.c", 0, 0, NULL, 0 };
+    free(inputs);
+    functionThreads = (int)nthreads;
+    // Entree standard lue au fil de l'eau; sur la sortie standard, seul le C y est ecrit
+    if (strcmp(job.input, "-") == 0) streamMode = 1;
+    int quiet = runMode || strcmp(job.output, "-") == 0;
 
-    current=nextToken();
-    PROGRAM();
+    if (benchLex) {
+        if (streamMode) {
+            fprintf(stderr, "Error: --bench-lex cannot be used with --stream\n");
+            return 1;
+        }
+        Compilation *c = newCompilation(stderr);
+        cc = c;
+        if (setjmp(c->failure) != 0 || openSource(job.input) != 0) {
+            if (!c->srcBuf) fprintf(stderr, "Error: cannot open '%s'\n", job.input);
+            freeCompilation(c);
+            return 1;
+        }
+        benchLexer(5);
+        freeCompilation(c);
+        return 0;
+    }
 
-    fclose(src);
-    fclose(out);
-    printf("Compilation reussie\n");
-    printf("Fichier compile: %s\n", output_file);
-    return 0;
+    if (!quiet) printf("Compilation du fichier %s\n", job.input);
+    fflush(stdout);
+    int rc = compileFile(&job, stderr, runMode);
+    if (runMode) return rc;
+    if (rc == 0 && !quiet) {
+        printf("Compilation reussie\n");
+        printf("Fichier compile: %s\n", job.output);
+        fflush(stdout);
+    }
+    if (cacheDir) cacheEvict();
+    return rc ? 1 : 0;
 }